@@ -18,7 +18,29 @@ Bot::Bot(const messages::config::Config &config,
       _networking(&_queue, &_keys.at(0), &_peers, _config.mutable_networking()),
       _ledger(std::make_shared<ledger::LedgerMongodb>(_config.database())),
       _update_timer(*_io_context),
-      _consensus_config(consensus_config) {
+      _consensus_config(consensus_config),
+      _block_sync(
+          [this](const messages::Message &message,
+                 networking::Connection::ID id) {
+            return _networking.send(message, id) !=
+                   networking::TransportLayer::SendResult::FAILED;
+          },
+          [this](const messages::Block &block) {
+            return _consensus->add_block_async(block);
+          },
+          [this](const messages::BlockID &id) {
+            messages::BlockHeader header;
+            return _ledger->get_block_header(id, &header);
+          }),
+      _coalescer(
+          [this](const messages::Message &message,
+                 networking::Connection::ID id) {
+            return _networking.send(message, id) !=
+                   networking::TransportLayer::SendResult::FAILED;
+          },
+          _config.networking().gossip_max_bytes(),
+          std::chrono::milliseconds(_config.networking().gossip_max_delay())),
+      _gossip_timer(*_io_context) {
   if (!init()) {
     throw std::runtime_error("Could not create bot from configuration file");
   }
@@ -55,15 +77,44 @@ void Bot::handler_get_block(const messages::Header &header,
       tip->mutable_id()->CopyFrom(tagged_block_tip.block().header().id());
     }
 
+  } else if (get_block.has_height() && get_block.headers_only()) {
+    // Always reply, less headers than asked means that this is our tip
+    const auto height = get_block.height();
+    const auto count = std::min(get_block.count(),
+                                networking::BlockSync::HEADERS_PER_REQUEST);
+    auto block_headers = message->add_bodies()->mutable_block_headers();
+    messages::Block block;
+    for (auto i = 0u; i < count; ++i) {
+      if (!_ledger->get_block(height + i, &block, false)) {
+        break;
+      }
+      block_headers->add_headers()->CopyFrom(block.header());
+    }
   } else if (get_block.has_height()) {
+    // The blocks are split in several replies that each fit in a message
     const auto height = get_block.height();
+    std::size_t reply_size = 0;
     for (auto i = 0u; i < get_block.count(); ++i) {
-      auto block = message->add_bodies()->mutable_block();
-      if (!_ledger->get_block(height + i, block)) {
+      messages::Body body;
+      if (!_ledger->get_block(height + i, body.mutable_block())) {
         LOG_DEBUG << this << " : " << _me.port()
                   << " get_block by height not found";
-        return;
+        break;
+      }
+      // With room for the tag and the length of the body in the message
+      const auto body_size = body.ByteSizeLong() + 8;
+      if (message->bodies_size() > 0 &&
+          reply_size + body_size > networking::BlockSync::MAX_REPLY_SIZE) {
+        _networking.reply(message);
+        message = std::make_shared<messages::Message>();
+        messages::fill_header_reply(header, message->mutable_header());
+        reply_size = 0;
       }
+      message->add_bodies()->Swap(&body);
+      reply_size += body_size;
+    }
+    if (message->bodies_size() == 0) {
+      return;
     }
   } else {
     LOG_ERROR << this << " : " << _me.port() << " get_block message ill-formed";
@@ -78,50 +129,262 @@ void Bot::handler_tip(const messages::Header &header,
 
   const auto &tip = body.tip();
   if (tip.has_id()) {
-    update_ledger(_ledger->new_missing_block(tip.id()));
+    const auto missing_block = _ledger->new_missing_block(tip.id());
+    if (missing_block) {
+      start_sync();
+    }
+    update_ledger(missing_block);
   } else {
     update_ledger();
   }
 }
 
-void Bot::handler_block(const messages::Header &header,
-                        const messages::Body &body) {
-  messages::Message message;
-  auto header_reply = message.mutable_header();
-  messages::fill_header(header_reply);
-  message.add_bodies()->mutable_block()->CopyFrom(body.block());
-  if (!header.has_request_id()) {
-    _networking.send_all(message);
+void Bot::handler_block_headers(const messages::Header &header,
+                                const messages::Body &body) {
+  if (!_block_sync.handle_headers(header, body.block_headers())) {
+    LOG_DEBUG << this << " : " << _me.port() << " Unexpected block headers";
   }
+}
 
-  if (!_consensus->add_block_async(body.block())) {
-    LOG_WARNING << "Consensus rejected block" << body.block().header().id();
+void Bot::handler_block(const messages::Header &header,
+                        const messages::Body &body) {
+  if (header.has_request_id() &&
+      _block_sync.handle_block(header, body.block())) {
     return;
   }
-  update_ledger(_ledger->new_missing_block(body.block().header().id()));
 
   if (header.has_request_id()) {
+    std::lock_guard lock(_request_ids_mutex);
     auto got = _request_ids.find(header.request_id());
     if (got == _request_ids.end()) {
       LOG_WARNING << "The request_id is wrong " << body.block().header().id();
     }
   }
+
+  add_received_block(body.block(), !header.has_request_id());
+}
+
+void Bot::handler_compact_block(const messages::Header &header,
+                                const messages::Body &body) {
+  const auto &compact_block = body.compact_block();
+  messages::BlockHeader block_header;
+  if (_ledger->get_block_header(compact_block.header().id(), &block_header)) {
+    return;
+  }
+
+  messages::Block block;
+  auto message = std::make_shared<messages::Message>();
+  messages::fill_header_reply(header, message->mutable_header());
+  auto get_block_transactions =
+      message->add_bodies()->mutable_get_block_transactions();
+  if (_compact_blocks.rebuild(compact_block, &block, get_block_transactions)) {
+    add_rebuilt_block(header, block);
+    return;
+  }
+
+  LOG_DEBUG << this << " : " << _me.port() << " Asking "
+            << get_block_transactions->indexes_size() << " / "
+            << compact_block.short_transaction_ids_size()
+            << " transactions of block " << compact_block.header().id();
+  _networking.reply(message);
+}
+
+void Bot::handler_get_block_transactions(const messages::Header &header,
+                                         const messages::Body &body) {
+  const auto &get_block_transactions = body.get_block_transactions();
+  messages::Block block;
+  if (!_ledger->get_block(get_block_transactions.block_id(), &block)) {
+    LOG_DEBUG << this << " : " << _me.port()
+              << " get_block_transactions not found for id "
+              << get_block_transactions.block_id();
+    return;
+  }
+  // The indexes are the ones of the block that was compacted
+  messages::sort_transactions(&block);
+
+  auto message = std::make_shared<messages::Message>();
+  messages::fill_header_reply(header, message->mutable_header());
+  if (!networking::CompactBlocks::get_transactions(
+          block, get_block_transactions,
+          message->add_bodies()->mutable_block_transactions())) {
+    LOG_ERROR << this << " : " << _me.port()
+              << " get_block_transactions message ill-formed";
+    return;
+  }
+  _networking.reply(message);
+}
+
+void Bot::handler_block_transactions(const messages::Header &header,
+                                     const messages::Body &body) {
+  messages::Block block;
+  if (!_compact_blocks.complete(body.block_transactions(), &block)) {
+    LOG_DEBUG << this << " : " << _me.port()
+              << " Unexpected transactions for block "
+              << body.block_transactions().block_id();
+    return;
+  }
+  add_rebuilt_block(header, block);
+}
+
+void Bot::add_rebuilt_block(const messages::Header &header,
+                            const messages::Block &block) {
+  // A wrong transaction with the same short id gives another block, which
+  // would be marked invalid under the id of the real one
+  if (!networking::CompactBlocks::check_block_id(block)) {
+    LOG_INFO << this << " : " << _me.port() << " Rebuilt block "
+             << block.header().id() << " does not match its id, asking it";
+    request_block(header, block.header().id());
+    return;
+  }
+  add_received_block(block, true);
+}
+
+void Bot::request_block(const messages::Header &header,
+                        const messages::BlockID &id) {
+  auto message = std::make_shared<messages::Message>();
+  const auto request_id =
+      messages::fill_header_reply(header, message->mutable_header());
+  auto get_block = message->add_bodies()->mutable_get_block();
+  get_block->mutable_hash()->CopyFrom(id);
+  get_block->set_count(1);
+  {
+    std::lock_guard lock(_request_ids_mutex);
+    _request_ids.insert(request_id);
+  }
+  _networking.reply(message);
+}
+
+void Bot::add_received_block(const messages::Block &block, bool relay) {
+  if (!_consensus->add_block_async(block)) {
+    LOG_WARNING << "Consensus rejected block" << block.header().id();
+    return;
+  }
+  // Only the blocks that were inserted are relayed so that a block already
+  // received from another peer is not sent again
+  if (relay) {
+    relay_block(block);
+  }
+
+  const auto missing_block = _ledger->new_missing_block(block.header().id());
+  if (missing_block) {
+    start_sync();
+  }
+  update_ledger(missing_block);
+}
+
+void Bot::relay_block(const messages::Block &block) const {
+  messages::Message message;
+  messages::fill_header(message.mutable_header());
+  auto body = message.add_bodies();
+  if (!networking::CompactBlocks::compact(block,
+                                          body->mutable_compact_block())) {
+    body->mutable_block()->CopyFrom(block);
+  }
+  _networking.send_all(message);
 }
 
 void Bot::handler_transaction(const messages::Header &header,
                               const messages::Body &body) {
-  if (_consensus->add_transaction(body.transaction())) {
-    messages::Message message;
-    messages::fill_header(message.mutable_header());
-    message.add_bodies()->mutable_transaction()->CopyFrom(body.transaction());
-    _networking.send_all(message);
+  std::optional<networking::Connection::ID> peer;
+  if (header.has_connection_id()) {
+    peer = header.connection_id();
+  }
+  const auto &transaction = body.transaction();
+  if (!_inventory.is_new_transaction(transaction.id(), peer)) {
+    return;
+  }
+  // A forged transaction must not prevent the real one from being asked
+  if (_consensus->add_transaction(transaction) &&
+      _inventory.add_transaction(transaction.id(), peer)) {
+    announce_transaction(transaction);
+  }
+}
+
+void Bot::handler_inventory(const messages::Header &header,
+                            const messages::Body &body) {
+  auto message = std::make_shared<messages::Message>();
+  messages::fill_header_reply(header, message->mutable_header());
+  if (_inventory.handle_inventory(
+          header.connection_id(), body.inventory(),
+          message->add_bodies()->mutable_get_inventory())) {
+    _networking.reply(message);
+  }
+}
+
+void Bot::handler_get_inventory(const messages::Header &header,
+                                const messages::Body &body) {
+  // The transactions are packed with the rest of the gossip to the peer
+  for (const auto &id : body.get_inventory().transaction_ids()) {
+    messages::Body transaction_body;
+    auto transaction = transaction_body.mutable_transaction();
+    if (_compact_blocks.get_transaction(id, transaction) ||
+        _ledger->get_transaction(id, transaction)) {
+      _coalescer.add(header.connection_id(), transaction_body);
+    }
   }
 }
 
+void Bot::announce_transaction(const messages::Transaction &transaction) const {
+  _compact_blocks.add_transaction(transaction);
+  std::vector<networking::Connection::ID> peers;
+  for (const auto &peer : _peers.connected_peers_copy()) {
+    if (peer.has_connection_id()) {
+      peers.push_back(peer.connection_id());
+    }
+  }
+  _inventory.announce_transaction(transaction.id(), peers);
+}
+
+void Bot::send_gossip() {
+  const auto now = Timer::now();
+  if (now - _last_inventory_flush >=
+      std::chrono::milliseconds(_config.networking().inventory_batch_time())) {
+    _last_inventory_flush = now;
+    for (const auto &[peer, inventory] : _inventory.flush()) {
+      messages::Body body;
+      body.mutable_inventory()->CopyFrom(inventory);
+      _coalescer.add(peer, body);
+    }
+    for (const auto &[peer, get_inventory] : _inventory.retry_requests()) {
+      messages::Body body;
+      body.mutable_get_inventory()->CopyFrom(get_inventory);
+      _coalescer.add(peer, body);
+    }
+  }
+  _coalescer.flush();
+
+  _gossip_timer.expires_at(
+      _gossip_timer.expiry() +
+      std::chrono::milliseconds(_config.networking().gossip_max_delay()));
+  _gossip_timer.async_wait(boost::bind(&Bot::send_gossip, this));
+}
+
+std::vector<networking::Connection::ID> Bot::connected_peer_ids() {
+  std::vector<networking::Connection::ID> ids;
+  for (const auto &peer : _peers.connected_peers_copy()) {
+    if (peer.has_connection_id()) {
+      ids.push_back(peer.connection_id());
+    }
+  }
+  return ids;
+}
+
+void Bot::start_sync() {
+  const auto tip = _ledger->get_main_branch_tip();
+  const auto &tip_header = tip.block().header();
+  _block_sync.start(tip_header.height(), tip_header.id(),
+                    connected_peer_ids());
+}
+
 bool Bot::update_ledger(const std::optional<messages::Hash> &missing_block) {
   if (!missing_block) {
     return false;
   }
+  if (_block_sync.is_running()) {
+    // The sync downloads the main branch of the peers, only the blocks of
+    // the other branches are asked by id once it is done
+    return false;
+  }
 
   auto message = std::make_shared<messages::Message>();
   auto header = message->mutable_header();
@@ -136,6 +399,7 @@ bool Bot::update_ledger(const std::optional<messages::Hash> &missing_block) {
     LOG_INFO << "no bot found to ask block " << *message;
   }
 
+  std::lock_guard lock(_request_ids_mutex);
   _request_ids.insert(idheader);
   return false;
 }
@@ -191,6 +455,42 @@ void Bot::subscribe() {
         this->handler_get_block(header, body);
       });
 
+  _subscriber.subscribe(
+      messages::Type::kBlockHeaders,
+      [this](const messages::Header &header, const messages::Body &body) {
+        this->handler_block_headers(header, body);
+      });
+
+  _subscriber.subscribe(
+      messages::Type::kCompactBlock,
+      [this](const messages::Header &header, const messages::Body &body) {
+        this->handler_compact_block(header, body);
+      });
+
+  _subscriber.subscribe(
+      messages::Type::kGetBlockTransactions,
+      [this](const messages::Header &header, const messages::Body &body) {
+        this->handler_get_block_transactions(header, body);
+      });
+
+  _subscriber.subscribe(
+      messages::Type::kBlockTransactions,
+      [this](const messages::Header &header, const messages::Body &body) {
+        this->handler_block_transactions(header, body);
+      });
+
+  _subscriber.subscribe(
+      messages::Type::kInventory,
+      [this](const messages::Header &header, const messages::Body &body) {
+        this->handler_inventory(header, body);
+      });
+
+  _subscriber.subscribe(
+      messages::Type::kGetInventory,
+      [this](const messages::Header &header, const messages::Body &body) {
+        this->handler_get_inventory(header, body);
+      });
+
   _subscriber.subscribe(
       messages::Type::kTip,
       [this](const messages::Header &header, const messages::Body &body) {
@@ -236,6 +536,8 @@ bool Bot::init() {
   }
 
   _tcp_config = _config.mutable_networking()->mutable_tcp();
+  _queue.set_limits(_config.networking().queue_max_size(),
+                    _config.networking().queue_max_per_peer());
 
   if (!_config.has_database()) {
     LOG_ERROR << "Missing db configuration";
@@ -246,6 +548,9 @@ bool Bot::init() {
   configure_networking(&_config);
   _update_timer.expires_after(1s);
   _update_timer.async_wait(boost::bind(&Bot::regular_update, this));
+  _gossip_timer.expires_after(
+      std::chrono::milliseconds(_config.networking().gossip_max_delay()));
+  _gossip_timer.async_wait(boost::bind(&Bot::send_gossip, this));
 
   _consensus = std::make_shared<consensus::Consensus>(
       _ledger, _keys, _consensus_config,
@@ -301,6 +606,7 @@ void Bot::handler_heart_beat(const messages::Header &header,
   _peers.update_unreachable();
   update_peerlist();
   keep_max_connections();
+  _block_sync.update(connected_peer_ids());
   update_ledger();
   _networking.clean_old_connections(
       _config.networking().keep_old_connection_time());
@@ -332,11 +638,11 @@ void Bot::send_pings() {
 }
 
 void Bot::send_random_transaction() {
-  const auto peers = _peers.connected_peers();
+  const auto peers = _peers.connected_peers_copy();
   if (peers.size() == 0) {
     return;
   }
-  const auto recipient = peers[rand() % peers.size()];
+  const auto &recipient = peers[rand() % peers.size()];
   messages::NCCAmount amount_to_send;
   if (_config.has_random_transaction_amount()) {
     amount_to_send.CopyFrom(_config.random_transaction_amount());
@@ -345,7 +651,7 @@ void Bot::send_random_transaction() {
   }
 
   const auto transaction = _ledger->send_ncc(
-      _keys[0].key_priv(), messages::_KeyPub(recipient->key_pub()),
+      _keys[0].key_priv(), messages::_KeyPub(recipient.key_pub()),
       amount_to_send);
   if (_consensus->add_transaction(transaction)) {
     LOG_DEBUG << this << " : " << _me.port() << " Sending random transaction "
@@ -430,6 +736,9 @@ void Bot::handler_connection(const messages::Header &header,
   messages::fill_header_reply(header, message->mutable_header());
   auto hello = message->add_bodies()->mutable_hello();
   hello->mutable_peer()->CopyFrom(_me);
+  if (_tcp_config->compression()) {
+    hello->add_compressions(messages::Compression::ZSTD);
+  }
 
   const auto tip = _ledger->get_main_branch_tip();
   hello->mutable_tip()->CopyFrom(tip.block().header().id());
@@ -450,17 +759,18 @@ void Bot::handler_deconnection(const messages::Header &header,
   if (header.has_connection_id()) {
     auto remote_peer = _networking.find_peer(header.connection_id());
     if (remote_peer) {
-      remote_peer->set_status(messages::Peer::UNREACHABLE);
+      _peers.set_status(remote_peer.get(), messages::Peer::UNREACHABLE);
       LOG_DEBUG << this << " : " << _me.port() << " disconnected from "
                 << remote_peer->port();
     }
     _networking.terminate(header.connection_id());
+    _inventory.remove_peer(header.connection_id());
   } else {
     // peer didn't create a connection
     if (body.connection_closed().has_peer()) {
       auto peer = _peers.find(body.connection_closed().peer().key_pub());
       if (peer) {
-        peer->set_status(messages::Peer::UNREACHABLE);
+        _peers.set_status(peer.get(), messages::Peer::UNREACHABLE);
         LOG_DEBUG << _me.port() << " can't connect to " << peer->port();
       }
     }
@@ -497,12 +807,20 @@ void Bot::handler_world(const messages::Header &header,
     LOG_DEBUG << this << " : " << _me.port() << " Not accepted from "
               << remote_peer_connection->port() << ", disconnecting";
     _networking.terminate(header.connection_id());
-    remote_peer_connection->set_status(messages::Peer::UNREACHABLE);
+    _peers.set_status(remote_peer_connection.get(),
+                      messages::Peer::UNREACHABLE);
   } else {
-    remote_peer_connection->set_status(messages::Peer::CONNECTED);
+    // Added before the status because the messages of the peer are only
+    // handled once it is connected
+    _inventory.add_peer(header.connection_id());
+    _peers.set_status(remote_peer_connection.get(), messages::Peer::CONNECTED);
   }
 
-  update_ledger(_ledger->new_missing_block(world));
+  const auto missing_block = _ledger->new_missing_block(world);
+  if (missing_block) {
+    start_sync();
+  }
+  update_ledger(missing_block);
 
   keep_max_connections();
 }
@@ -557,7 +875,7 @@ void Bot::handler_hello(const messages::Header &header,
   auto peers = message->add_bodies()->mutable_peers();
   const bool accepted = _peers.used_peers_count() < _max_incoming_connections;
   if (accepted) {
-    remote_peer_connection->set_status(messages::Peer::CONNECTING);
+    _peers.set_status(remote_peer_connection.get(), messages::Peer::CONNECTING);
   }
   const auto tip = _ledger->get_main_branch_tip();
   world->mutable_missing_block()->CopyFrom(tip.block().header().id());
@@ -565,25 +883,33 @@ void Bot::handler_hello(const messages::Header &header,
   auto header_reply = message->mutable_header();
   messages::fill_header_reply(header, header_reply);
   world->set_accepted(accepted);
+  if (_tcp_config->compression()) {
+    world->add_compressions(messages::Compression::ZSTD);
+  }
 
   _peers.fill(peers);
 
+  const auto connection_id = header.connection_id();
   _deferred_world.emplace_back([accepted, remote_peer_connection, this,
-                                message]() {
+                                message, connection_id]() {
     // update peer status
     if (accepted) {
-      remote_peer_connection->set_status(messages::Peer::CONNECTED);
+      _inventory.add_peer(connection_id);
+      _peers.set_status(remote_peer_connection.get(),
+                        messages::Peer::CONNECTED);
       LOG_DEBUG << _me.port() << " Accept status "
                 << std::boolalpha << accepted << " " << *remote_peer_connection
                 << std::endl
                 << _peers;
     } else {
-      remote_peer_connection->set_status(messages::Peer::UNREACHABLE);
+      _peers.set_status(remote_peer_connection.get(),
+                        messages::Peer::UNREACHABLE);
     }
 
     if (!_networking.reply(message)) {
       LOG_ERROR << this << " : " << _me.port() << " Failed to send world message";
-      remote_peer_connection->set_status(messages::Peer::UNREACHABLE);
+      _peers.set_status(remote_peer_connection.get(),
+                        messages::Peer::UNREACHABLE);
     }
   });
 }
@@ -607,8 +933,8 @@ std::ostream &operator<<(std::ostream &os, const neuro::Bot &bot) {
   return os;
 }
 
-std::vector<messages::Peer *> Bot::connected_peers() {
-  return _peers.connected_peers();
+std::vector<messages::Peer> Bot::connected_peers() {
+  return _peers.connected_peers_copy();
 }
 
 void Bot::keep_max_connections() {
@@ -632,9 +958,9 @@ void Bot::keep_max_connections() {
 
   LOG_DEBUG << this << " : " << _me.port() << " Asking to connect to "
             << **peer_it;
-  (*peer_it)->set_status(messages::Peer::CONNECTING);
+  _peers.set_status((*peer_it).get(), messages::Peer::CONNECTING);
   if (!_networking.connect(*peer_it)) {
-    (*peer_it)->set_status(messages::Peer::UNREACHABLE);
+    _peers.set_status((*peer_it).get(), messages::Peer::UNREACHABLE);
   }
 }
 
@@ -658,30 +984,32 @@ void Bot::subscribe(const messages::Type type,
 
 bool Bot::publish_transaction(const messages::Transaction &transaction) const {
   // Add the transaction to the transaction pool
-  _consensus->add_transaction(transaction);
+  if (!_consensus->add_transaction(transaction)) {
+    LOG_INFO << "Consensus rejected transaction " << transaction.id();
+    return false;
+  }
 
-  // Send the transaction on the network
-  messages::Message message;
-  messages::fill_header(message.mutable_header());
-  auto body = message.add_bodies();
-  body->mutable_transaction()->CopyFrom(transaction);
-  return _networking.send_all(message) !=
-         networking::TransportLayer::SendResult::FAILED;
+  // Announce the transaction on the network, the peers will ask it
+  _inventory.add_transaction(transaction.id(), {});
+  announce_transaction(transaction);
+  return _networking.peer_count() > 0;
 }
 
 void Bot::publish_block(const messages::Block &block) const {
-  // Send the transaction on the network
-  messages::Message message;
-  messages::fill_header(message.mutable_header());
-  auto body = message.add_bodies();
-  body->mutable_block()->CopyFrom(block);
-  _networking.send_all(message);
+  // Send the block on the network
+  relay_block(block);
 
   LOG_INFO << "Publishing block " << block;
 }
 
 ledger::Ledger *Bot::ledger() { return _ledger.get(); }
 
+consensus::Consensus *Bot::consensus() { return _consensus.get(); }
+
+const networking::Inventory &Bot::inventory() const { return _inventory; }
+
+const messages::Queue &Bot::queue() const { return _queue; }
+
 void Bot::join() { _networking.join(); }
 
 Bot::~Bot() {
@@ -689,6 +1017,7 @@ Bot::~Bot() {
             << &_subscriber;
 
   _update_timer.cancel();
+  _gossip_timer.cancel();
   _io_context->stop();
 
   while (!_io_context->stopped()) {
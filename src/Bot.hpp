@@ -22,6 +22,10 @@
 #include "messages/Queue.hpp"
 #include "messages/Subscriber.hpp"
 #include "messages/config/Config.hpp"
+#include "networking/BlockSync.hpp"
+#include "networking/Coalescer.hpp"
+#include "networking/CompactBlocks.hpp"
+#include "networking/Inventory.hpp"
 #include "networking/Networking.hpp"
 #include "networking/tcp/Tcp.hpp"
 
@@ -54,8 +58,17 @@ private:
   boost::asio::steady_timer _update_timer;
   std::optional<consensus::Config> _consensus_config;
   std::shared_ptr<consensus::Consensus> _consensus;
+  networking::BlockSync _block_sync;
+  //! transactions received recently to rebuild the compact blocks
+  mutable networking::CompactBlocks _compact_blocks;
+  mutable networking::Inventory _inventory;
+  Timer::time_point _last_inventory_flush;
+  networking::Coalescer _coalescer;
+  boost::asio::steady_timer _gossip_timer;
   std::unique_ptr<api::Api> _rest_api;
   std::unique_ptr<api::Api> _grpc_api;
+  //! the block handlers and the heartbeat run in different queue workers
+  mutable std::mutex _request_ids_mutex;
   std::unordered_set<int32_t> _request_ids;
   std::thread _io_context_thread;
   std::vector<std::function<void(void)>> _deferred_world;
@@ -93,6 +106,27 @@ private:
                      const messages::Body &body);
   void handler_get_block(const messages::Header &header,
                          const messages::Body &body);
+  void handler_block_headers(const messages::Header &header,
+                             const messages::Body &body);
+  void handler_compact_block(const messages::Header &header,
+                             const messages::Body &body);
+  void handler_get_block_transactions(const messages::Header &header,
+                                      const messages::Body &body);
+  void handler_block_transactions(const messages::Header &header,
+                                  const messages::Body &body);
+  void handler_inventory(const messages::Header &header,
+                         const messages::Body &body);
+  void handler_get_inventory(const messages::Header &header,
+                             const messages::Body &body);
+  void announce_transaction(const messages::Transaction &transaction) const;
+  void send_gossip();
+  void add_received_block(const messages::Block &block, bool relay);
+  void add_rebuilt_block(const messages::Header &header,
+                         const messages::Block &block);
+  //! ask a block to the peer that sent header
+  void request_block(const messages::Header &header,
+                     const messages::BlockID &id);
+  void relay_block(const messages::Block &block) const;
   void handler_tip(const messages::Header &header, const messages::Body &body);
   void handler_get_peers(const messages::Header &header,
                          const messages::Body &body);
@@ -105,6 +139,8 @@ private:
   void regular_update();
   void send_random_transaction();
   void send_pings();
+  std::vector<networking::Connection::ID> connected_peer_ids();
+  void start_sync();
   void update_ledger();
   bool update_ledger(const std::optional<messages::Hash> &missing_block);
   void update_peerlist();
@@ -123,13 +159,18 @@ public:
   const messages::Peers &peers() const;
   const messages::_Peers remote_peers() const;
   void keep_max_connections();
-  std::vector<messages::Peer *> connected_peers();
+  //! copies of the connected peers taken under the lock of the peers
+  std::vector<messages::Peer> connected_peers();
   void subscribe(const messages::Type type,
                  messages::Subscriber::Callback callback);
 
+  //! false if the consensus rejected the transaction or no peer is connected
   bool publish_transaction(const messages::Transaction &transaction) const;
   void publish_block(const messages::Block &block) const;
   ledger::Ledger *ledger();
+  consensus::Consensus *consensus();
+  const networking::Inventory &inventory() const;
+  const messages::Queue &queue() const;
 
   friend class neuro::tests::BotTest;
   friend class neuro::tooling::FullSimulator;
@@ -182,6 +182,40 @@ messages::Status::PeerCount Monitoring::peer_count() const {
   return peerCount;
 }
 
+messages::Status::Gossip Monitoring::gossip() const {
+  messages::Status::Gossip gossip;
+  const auto &inventory = _bot->inventory();
+  gossip.set_announced(inventory.announced());
+  gossip.set_requested(inventory.requested());
+  gossip.set_received(inventory.received());
+  gossip.set_duplicates(inventory.duplicates());
+  return gossip;
+}
+
+void Monitoring::queue_lanes(messages::Status *status) const {
+  using Milliseconds = std::chrono::duration<float, std::milli>;
+  for (const auto &lane_status : _bot->queue().lanes_status()) {
+    auto lane = status->add_queue();
+    lane->set_name(lane_status.name);
+    lane->set_depth(lane_status.depth);
+    lane->set_popped(lane_status.popped);
+    if (lane_status.popped > 0) {
+      lane->set_average_wait(Milliseconds(lane_status.total_wait).count() /
+                             lane_status.popped);
+    }
+    lane->set_max_wait(Milliseconds(lane_status.max_wait).count());
+  }
+}
+
+float Monitoring::transaction_cache_hit_rate() const {
+  // The status can be asked before the consensus is initialized
+  const auto consensus = _bot->consensus();
+  if (consensus == nullptr) {
+    return 0;
+  }
+  return consensus->transaction_cache().hit_rate();
+}
+
 messages::Status_BlockChain Monitoring::blockchain_health() const {
   messages::Status_BlockChain health;
   health.set_last_block_ts(last_block_ts());
@@ -192,6 +226,7 @@ messages::Status_BlockChain Monitoring::blockchain_health() const {
   health.set_nb_transactions_1h(nb_transactions_1h());
   health.set_average_block_propagation_5m(average_block_propagation_5m());
   health.set_average_block_propagation_1h(average_block_propagation_1h());
+  health.set_transaction_cache_hit_rate(transaction_cache_hit_rate());
   return health;
 }
 
@@ -200,6 +235,8 @@ messages::Status Monitoring::fast_status() const {
   status.mutable_bot()->CopyFrom(bot());
   status.mutable_fs()->CopyFrom(filesystem_usage());
   status.mutable_peer()->CopyFrom(peer_count());
+  status.mutable_gossip()->CopyFrom(gossip());
+  queue_lanes(&status);
   status.mutable_blockchain()->CopyFrom(blockchain_health());
   return status;
 }
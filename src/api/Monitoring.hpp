@@ -18,6 +18,7 @@ class Monitoring {
   const TimePoint _starting_time = std::chrono::system_clock::now();
 
   void resource_usage(messages::Status::Bot* bot) const;
+  void queue_lanes(messages::Status* status) const;
 
  public:
   explicit Monitoring(Bot* bot);
@@ -34,8 +35,10 @@ class Monitoring {
   float average_block_propagation_since(std::time_t since) const;
   float average_block_propagation_5m() const;
   float average_block_propagation_1h() const;
+  float transaction_cache_hit_rate() const;
   messages::Status::FileSystem filesystem_usage() const;
   messages::Status::PeerCount peer_count() const;
+  messages::Status::Gossip gossip() const;
   messages::Status_BlockChain blockchain_health() const;
   messages::Status fast_status() const;
   messages::Status complete_status() const;
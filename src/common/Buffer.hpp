@@ -4,14 +4,51 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include "common/types.hpp"
 
 namespace neuro {
 
-class Buffer : public std::vector<uint8_t> {
+/**
+ * \brief Allocator that default initializes the elements, so that growing a
+ * vector of bytes with resize() does not zero fill the new bytes
+ */
+template <typename T, typename A = std::allocator<T>>
+class DefaultInitAllocator : public A {
+  using Traits = std::allocator_traits<A>;
+
+ public:
+  template <typename U>
+  struct rebind {
+    using other =
+        DefaultInitAllocator<U, typename Traits::template rebind_alloc<U>>;
+  };
+
+  using A::A;
+
+  template <typename U>
+  void construct(U *ptr) noexcept(
+      std::is_nothrow_default_constructible<U>::value) {
+    ::new (static_cast<void *>(ptr)) U;
+  }
+
+  template <typename U, typename... Args>
+  void construct(U *ptr, Args &&... args) {
+    Traits::construct(static_cast<A &>(*this), ptr,
+                      std::forward<Args>(args)...);
+  }
+};
+
+/**
+ * \brief Vector of bytes, resize() leaves the new bytes uninitialized
+ */
+class Buffer : public std::vector<uint8_t, DefaultInitAllocator<uint8_t>> {
  public:
+  using Vector = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
   enum class InputType { RAW, HEX /*, B64*/ };
 
  private:
@@ -35,13 +72,12 @@ class Buffer : public std::vector<uint8_t> {
   Buffer() = default;
   Buffer(const Buffer &) = default;
   Buffer(Buffer &&) = default;
-  Buffer(size_type count, uint8_t v) : std::vector<uint8_t>(count, v) {}
+  Buffer(size_type count, uint8_t v) : Vector(count, v) {}
   Buffer(const uint8_t *data, const std::size_t size) { copy(data, size); }
   Buffer(const char *data, const std::size_t size) {
     copy(reinterpret_cast<const uint8_t *>(data), size);
   }
-  explicit Buffer(const std::initializer_list<uint8_t> init)
-      : vector<uint8_t>(init) {}
+  explicit Buffer(const std::initializer_list<uint8_t> init) : Vector(init) {}
 
   Buffer(const std::string &string,
          const InputType input_type = InputType::RAW);
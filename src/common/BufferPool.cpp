@@ -0,0 +1,82 @@
+#include "common/BufferPool.hpp"
+
+namespace neuro {
+
+BufferPool::BufferPool(std::size_t max_buffers_per_class)
+    : _max_buffers_per_class(max_buffers_per_class) {}
+
+BufferPool &BufferPool::instance() {
+  static auto *pool = new BufferPool();
+  return *pool;
+}
+
+std::size_t BufferPool::capacity(std::size_t size_class) {
+  return MIN_CAPACITY << size_class;
+}
+
+std::shared_ptr<Buffer> BufferPool::acquire(std::size_t size) {
+  std::size_t size_class = 0;
+  while (size_class < NB_SIZE_CLASSES && capacity(size_class) < size) {
+    size_class++;
+  }
+  if (size_class == NB_SIZE_CLASSES) {
+    // Too big to be pooled
+    _allocations++;
+    auto buffer = std::make_shared<Buffer>();
+    buffer->resize(size);
+    return buffer;
+  }
+
+  std::unique_ptr<Buffer> buffer;
+  {
+    std::lock_guard lock(_mutex);
+    auto &buffers = _buffers[size_class];
+    if (!buffers.empty()) {
+      buffer = std::move(buffers.back());
+      buffers.pop_back();
+    }
+  }
+  if (buffer) {
+    _reuses++;
+  } else {
+    _allocations++;
+    buffer = std::make_unique<Buffer>();
+    buffer->reserve(capacity(size_class));
+  }
+  buffer->resize(size);
+  return std::shared_ptr<Buffer>(buffer.release(),
+                                 [this](Buffer *buffer) { release(buffer); });
+}
+
+void BufferPool::release(Buffer *buffer) {
+  std::unique_ptr<Buffer> owned_buffer(buffer);
+  // The buffer may have grown, use the biggest class that it can hold
+  if (owned_buffer->capacity() < MIN_CAPACITY) {
+    return;
+  }
+  std::size_t size_class = 0;
+  while (size_class + 1 < NB_SIZE_CLASSES &&
+         capacity(size_class + 1) <= owned_buffer->capacity()) {
+    size_class++;
+  }
+  std::lock_guard lock(_mutex);
+  auto &buffers = _buffers[size_class];
+  if (buffers.size() < _max_buffers_per_class) {
+    buffers.push_back(std::move(owned_buffer));
+  }
+}
+
+std::size_t BufferPool::allocations() const { return _allocations; }
+
+std::size_t BufferPool::reuses() const { return _reuses; }
+
+std::size_t BufferPool::size() const {
+  std::lock_guard lock(_mutex);
+  std::size_t size = 0;
+  for (const auto &buffers : _buffers) {
+    size += buffers.size();
+  }
+  return size;
+}
+
+}  // namespace neuro
@@ -0,0 +1,63 @@
+#ifndef NEURO_SRC_COMMON_BUFFERPOOL_HPP
+#define NEURO_SRC_COMMON_BUFFERPOOL_HPP
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/Buffer.hpp"
+
+namespace neuro {
+
+/**
+ * \brief Pool of buffers sorted in power of two size classes
+ *
+ * A buffer acquired from the pool goes back to it when its last shared_ptr is
+ * released so that its memory is reused by the next message of the same size
+ * class instead of being freed and allocated again.
+ */
+class BufferPool {
+ public:
+  static constexpr std::size_t MIN_CAPACITY = 256;
+  //! the biggest class holds a full frame of MAX_MESSAGE_SIZE bytes
+  static constexpr std::size_t NB_SIZE_CLASSES = 12;
+  static constexpr std::size_t MAX_BUFFERS_PER_CLASS = 64;
+
+ private:
+  const std::size_t _max_buffers_per_class;
+  mutable std::mutex _mutex;
+  std::array<std::vector<std::unique_ptr<Buffer>>, NB_SIZE_CLASSES> _buffers;
+  std::atomic<std::size_t> _allocations{0};
+  std::atomic<std::size_t> _reuses{0};
+
+  void release(Buffer *buffer);
+
+ public:
+  explicit BufferPool(
+      std::size_t max_buffers_per_class = MAX_BUFFERS_PER_CLASS);
+
+  /**
+   * \brief Pool shared by the whole process, it is never destroyed so that
+   * buffers can be released at any time
+   */
+  static BufferPool &instance();
+
+  static std::size_t capacity(std::size_t size_class);
+
+  /**
+   * \brief Get a buffer of the given size, its content is uninitialized
+   */
+  std::shared_ptr<Buffer> acquire(std::size_t size);
+
+  //! number of buffers allocated because the pool had none available
+  std::size_t allocations() const;
+  //! number of buffers taken from the pool
+  std::size_t reuses() const;
+  std::size_t size() const;
+};
+
+}  // namespace neuro
+
+#endif /* NEURO_SRC_COMMON_BUFFERPOOL_HPP */
@@ -0,0 +1,66 @@
+#ifndef NEURO_SRC_COMMON_MPSCQUEUE_HPP
+#define NEURO_SRC_COMMON_MPSCQUEUE_HPP
+
+#include <atomic>
+#include <utility>
+
+namespace neuro {
+
+/**
+ * \brief Unbounded multi producer single consumer queue
+ *
+ * push() is a single atomic exchange and never blocks. pop() must not be
+ * called concurrently, the caller serializes the consumers. A push that is
+ * not finished yet can hide the values pushed after it, pop() then returns
+ * false until it is done.
+ */
+template <typename T>
+class MpscQueue {
+ private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    T value;
+
+    Node() = default;
+    explicit Node(T &&value) : value(std::move(value)) {}
+  };
+
+  //! last pushed node, swapped by the producers
+  alignas(64) std::atomic<Node *> _head;
+  //! the node before the next value, only used by the consumer
+  alignas(64) Node *_tail;
+
+ public:
+  MpscQueue() : _head(new Node()), _tail(_head.load()) {}
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  ~MpscQueue() {
+    while (_tail != nullptr) {
+      auto next = _tail->next.load(std::memory_order_relaxed);
+      delete _tail;
+      _tail = next;
+    }
+  }
+
+  void push(T value) {
+    auto node = new Node(std::move(value));
+    auto previous = _head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+  }
+
+  bool pop(T *value) {
+    auto next = _tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return false;
+    }
+    *value = std::move(next->value);
+    delete _tail;
+    _tail = next;
+    return true;
+  }
+};
+
+}  // namespace neuro
+
+#endif /* NEURO_SRC_COMMON_MPSCQUEUE_HPP */
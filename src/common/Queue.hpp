@@ -1,7 +1,9 @@
 #ifndef NEURO_SRC_COMMON_MESSAGEQUEUE_HPP
 #define NEURO_SRC_COMMON_MESSAGEQUEUE_HPP
 
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -9,9 +11,14 @@
 #include <map>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <shared_mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
+#include "common/MpscQueue.hpp"
 #include "common/logger.hpp"
 #include "common/types.hpp"
 
@@ -28,76 +35,265 @@ class Queue {
  public:
   using Callback = std::function<void(std::shared_ptr<const Payload>)>;
   using Filter = std::function<bool(std::shared_ptr<const Payload>)>;
+  //! connection a payload was received from
+  using Source = uint32_t;
+  //! lane of a payload, the lanes with a lower index are served first
+  using LaneOf = std::function<std::size_t(const Payload &)>;
+  using SourceOf = std::function<std::optional<Source>(const Payload &)>;
+  //! called once a paused source can push again
+  using Resume = std::function<void()>;
+
+  static constexpr std::size_t DEFAULT_MAX_SIZE = 4096;
+  static constexpr std::size_t DEFAULT_MAX_PER_SOURCE = 256;
+  //! a worker waits that long for a push that is not finished yet
+  static constexpr std::chrono::milliseconds PUSH_WAIT{1};
+
+  struct LaneStatus {
+    std::string name;
+    std::size_t depth = 0;
+    uint64_t popped = 0;
+    Timer::duration total_wait{0};
+    Timer::duration max_wait{0};
+  };
+
+  //! sources are counted modulo MAX_SOURCES
+  static constexpr std::size_t MAX_SOURCES = 1 << 16;
 
  protected:
+  struct Entry {
+    std::shared_ptr<const Payload> payload;
+    std::optional<Source> source;
+    Timer::time_point push_time;
+  };
+
+  struct Lane {
+    MpscQueue<Entry> entries;
+    std::string name;
+    //! a worker is taking or handling a payload of the lane, it is the only
+    //! consumer of the entries
+    std::atomic<bool> is_busy{false};
+    std::atomic<std::size_t> depth{0};
+    std::atomic<uint64_t> popped{0};
+    std::atomic<Timer::rep> total_wait{0};
+    std::atomic<Timer::rep> max_wait{0};
+  };
+
+  std::atomic<uint32_t> &queued(Source source) const {
+    return _sources[source % MAX_SOURCES];
+  }
+
+  //! the source is over its share, either its own bound or, if the queue is
+  //! full, any message queued
+  bool is_over_share(Source source) const {
+    const std::size_t source_size = queued(source);
+    return source_size >= _max_per_source ||
+           (_size >= _max_size && source_size > 0);
+  }
+
+  //! a paused source is resumed below half of the bounds so that it does not
+  //! pause again right away
+  bool can_resume(Source source) const {
+    const std::size_t source_size = queued(source);
+    return source_size <= _max_per_source / 2 &&
+           (_size <= _max_size / 2 || source_size == 0);
+  }
+
+  bool has_ready_lane() const {
+    for (const auto &lane : _lanes) {
+      if (lane->depth > 0 && !lane->is_busy) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void resume_sources() {
+    std::vector<Resume> resumes;
+    {
+      std::lock_guard<std::mutex> lock_paused(_paused_mutex);
+      for (auto it = _paused.begin(); it != _paused.end();) {
+        if (can_resume(it->first)) {
+          resumes.push_back(std::move(it->second));
+          it = _paused.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      _nb_paused = _paused.size();
+    }
+    for (const auto &resume : resumes) {
+      resume();
+    }
+  }
+
+  //! wake up a parked worker, if any
+  void notify() {
+    if (_nb_parked > 0) {
+      // The worker is either before its last check or waiting
+      { std::lock_guard<std::mutex> lock_park(_park_mutex); }
+      _condition.notify_one();
+    }
+  }
+
   /*!
     \fn std::shared_ptr<const Payload>
           Queue::next_message() \brief Protected method to retrieve from the
-          queue the next message to trait \return A shared pointer to a constant
-          Payload
+          queue the next message to trait, from the first lane that is not
+          empty nor busy \param reserved_lane if set, the lane of the message
+          is busy until it is released \param is_push_pending if set, true
+          when a lane was counted but its push is not finished yet \return A
+          shared pointer to a constant Payload, nullptr if there is no message
+          ready
   */
-  std::shared_ptr<const Payload> next_message() {
-    std::lock_guard<std::mutex> lock_queue(_queue_mutex);
-    auto message = _queue.front();
-    _queue.pop();
-    return message;
+  std::shared_ptr<const Payload> next_message(
+      std::size_t *reserved_lane = nullptr, bool *is_push_pending = nullptr) {
+    for (std::size_t i = 0; i < _lanes.size(); i++) {
+      auto &lane = *_lanes[i];
+      if (lane.depth == 0 || lane.is_busy.exchange(true)) {
+        continue;
+      }
+      Entry entry;
+      if (!lane.entries.pop(&entry)) {
+        // A push is not finished yet, the lane looks ready until it is
+        lane.is_busy = false;
+        if (is_push_pending != nullptr) {
+          *is_push_pending = true;
+        }
+        continue;
+      }
+      lane.depth--;
+      _size--;
+      if (entry.source) {
+        queued(*entry.source)--;
+      }
+      const auto wait = (Timer::now() - entry.push_time).count();
+      lane.popped++;
+      lane.total_wait += wait;
+      auto max_wait = lane.max_wait.load();
+      while (wait > max_wait &&
+             !lane.max_wait.compare_exchange_weak(max_wait, wait)) {
+      }
+      if (reserved_lane != nullptr) {
+        *reserved_lane = i;
+      } else {
+        release(i);
+      }
+      if (_nb_paused > 0) {
+        resume_sources();
+      }
+      return entry.payload;
+    }
+    return nullptr;
+  }
+
+  //! let the other workers handle the next payloads of a reserved lane
+  void release(std::size_t lane) {
+    _lanes[lane]->is_busy = false;
+    if (_lanes[lane]->depth > 0) {
+      notify();
+    }
   }
   /*!
           \fn bool Queue::is_empty() const
           \brief Protected method to check if the message queue is empty or not
           \return True if there is no message in _queue, false otherwise
    */
-  bool is_empty() {
-    std::lock_guard<std::mutex> lock_queue(_queue_mutex);
-    return _queue.empty();
+  bool is_empty() const { return _size == 0; }
+
+  /*!
+    \brief Set the lanes of the queue, it should be called before pushing
+    \param names name of each lane, in the order they are served
+    \param lane_of lane of a payload, lower than the number of names
+  */
+  void set_lanes(const std::vector<std::string> &names, const LaneOf &lane_of) {
+    _lanes.clear();
+    for (const auto &name : names) {
+      _lanes.push_back(std::make_unique<Lane>());
+      _lanes.back()->name = name;
+    }
+    _lane_of = lane_of;
   }
+
+  //! it should be called before pushing
+  void set_source_of(const SourceOf &source_of) {
+    _source_of = source_of;
+    _sources = std::make_unique<std::atomic<uint32_t>[]>(MAX_SOURCES);
+  }
+
   /*!
                 \fn bool Queue::do_work()
                 \brief Protected method that has the main loop of the
      Queue
 
      It is called from the Queue::run() to enter the
-     Queue thread and start its main loop
+     Queue threads and start their main loop. A lane is handled by a single
+     worker at a time so that its payloads keep their order, the workers
+     handle different lanes in parallel.
   */
   void do_work() {
-    do {
-      while (!_quitting && this->is_empty()) {  // avoid spurious wakeups
-        std::unique_lock<std::mutex> lock_queue(_queue_mutex);
-        _condition.wait_for(lock_queue, 1s);
-      }
-      // we validate again that the woke up call was not because it is quitting
-      if (_quitting) {
-        break;
+    while (!_quitting) {
+      std::size_t lane;
+      bool is_push_pending = false;
+      auto message = this->next_message(&lane, &is_push_pending);
+      if (!message) {
+        // Park until a lane is ready, _nb_parked is incremented before the
+        // last check so that a push either sees it or is seen by the check
+        std::unique_lock<std::mutex> lock_park(_park_mutex);
+        _nb_parked++;
+        if (is_push_pending) {
+          // The lane of the pending push stays ready, so the worker waits
+          // for the end of the push instead of spinning on the lane
+          _condition.wait_for(lock_park, PUSH_WAIT);
+        } else {
+          _condition.wait(lock_park,
+                          [this]() { return _quitting || has_ready_lane(); });
+        }
+        _nb_parked--;
+        continue;
       }
-      auto message = this->next_message();
       // for every body in the message we get the type
       {
-        std::lock_guard<std::mutex> lock_callbacks(_callbacks_mutex);
+        std::shared_lock<std::shared_mutex> lock_callbacks(_callbacks_mutex);
         for (auto &subscriber : _subscribers) {
           subscriber->handler(message);
         }
       }
-    } while (!_quitting);
+      release(lane);
+    }
   }
 
  protected:
   bool _started{false};
   std::unordered_set<Subscriber *> _subscribers;
   /*!
-    \var std::queue<std::shared_ptr<const Payload>> _queue
-    \brief Main queue with all the Payload that has been pushed
+    \var std::vector<std::unique_ptr<Lane>> _lanes
+    \brief Lanes with all the Payload that has been pushed
      and need to be distributed
    */
-  std::queue<std::shared_ptr<const Payload>> _queue;
-  std::mutex _queue_mutex;
-  mutable std::mutex _callbacks_mutex;
+  std::vector<std::unique_ptr<Lane>> _lanes;
+  LaneOf _lane_of;
+  SourceOf _source_of;
+  //! number of payloads queued per source
+  std::unique_ptr<std::atomic<uint32_t>[]> _sources;
+  std::unordered_map<Source, Resume> _paused;
+  std::atomic<std::size_t> _nb_paused{0};
+  std::mutex _paused_mutex;
+  std::atomic<std::size_t> _max_size{DEFAULT_MAX_SIZE};
+  std::atomic<std::size_t> _max_per_source{DEFAULT_MAX_PER_SOURCE};
+  std::atomic<std::size_t> _size{0};
+  //! held shared by the workers while they call the subscribers
+  mutable std::shared_mutex _callbacks_mutex;
   std::atomic<bool> _quitting{false};
-  std::thread _main_thread;
+  std::size_t _nb_workers{1};
+  std::vector<std::thread> _workers;
+  //! only used to park the idle workers
+  std::mutex _park_mutex;
   std::condition_variable _condition;
+  std::atomic<std::size_t> _nb_parked{0};
   std::vector<Filter> _filters;
 
  public:
-  Queue() = default;
+  Queue() { set_lanes({""}, nullptr); }
 
   void add_filter_input(const Filter &filter) { _filters.push_back(filter); }
 
@@ -114,26 +310,75 @@ class Queue {
       }
     }
 
-    {
-      std::lock_guard<std::mutex> lock_queue(_queue_mutex);
-      _queue.push(message);
+    Entry entry{message, {}, Timer::now()};
+    if (_source_of) {
+      entry.source = _source_of(*message);
     }
-    _condition.notify_all();
+    if (entry.source) {
+      queued(*entry.source)++;
+    }
+    const auto lane = _lane_of ? _lane_of(*message) : 0;
+    assert(lane < _lanes.size());
+    _lanes[lane]->entries.push(std::move(entry));
+    _size++;
+    _lanes[lane]->depth++;
+    notify();
 
     return true;
   }
 
+  /*!
+    \brief Pause a source over its share of the queue, payloads are never
+    dropped so the source should stop pushing until it is resumed
+    \param resume called from a queue thread once the source can push again
+    \return true if the source is paused, resume is then called later
+  */
+  bool pause(Source source, const Resume &resume) {
+    if (!_sources || !is_over_share(source)) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock_paused(_paused_mutex);
+    _paused[source] = resume;
+    _nb_paused = _paused.size();
+    // The queue may have been drained before _nb_paused was set
+    if (can_resume(source)) {
+      _paused.erase(source);
+      _nb_paused = _paused.size();
+      return false;
+    }
+    return true;
+  }
+
+  void set_limits(std::size_t max_size, std::size_t max_per_source) {
+    _max_size = max_size;
+    _max_per_source = max_per_source;
+  }
+
+  std::vector<LaneStatus> lanes_status() const {
+    std::vector<LaneStatus> status;
+    for (const auto &lane : _lanes) {
+      auto &lane_status = status.emplace_back();
+      lane_status.name = lane->name;
+      lane_status.depth = lane->depth;
+      lane_status.popped = lane->popped;
+      lane_status.total_wait = Timer::duration(lane->total_wait);
+      lane_status.max_wait = Timer::duration(lane->max_wait);
+    }
+    return status;
+  }
+
   void subscribe(Subscriber *subscriber) {
-    std::lock_guard<std::mutex> lock_callbacks(_callbacks_mutex);
+    std::unique_lock<std::shared_mutex> lock_callbacks(_callbacks_mutex);
     _subscribers.insert(subscriber);
   }
 
+  //! waits for the workers calling the subscriber
   void unsubscribe(Subscriber *subscriber) {
-    std::lock_guard<std::mutex> lock_callbacks(_callbacks_mutex);
+    std::unique_lock<std::shared_mutex> lock_callbacks(_callbacks_mutex);
     _subscribers.erase(subscriber);
   }
 
-  std::size_t size() const { return _queue.size(); }
+  std::size_t size() const { return _size; }
   /*!
     \fn void Queue::run()
     \brief Public method that need to me called in order for the Queue to
@@ -141,7 +386,17 @@ class Queue {
   */
   void run() {
     _started = true;
-    _main_thread = std::thread([this]() { this->do_work(); });
+    for (std::size_t i = 0; i < _nb_workers; i++) {
+      _workers.emplace_back([this]() { this->do_work(); });
+    }
+  }
+
+  /*!
+    \brief Set the number of threads calling the subscribers, more workers than
+    lanes are useless. It should be called before run()
+  */
+  void set_workers(std::size_t nb_workers) {
+    _nb_workers = std::max<std::size_t>(nb_workers, 1);
   }
 
   /*!
@@ -156,9 +411,14 @@ class Queue {
       return;
     }
     _quitting = true;
-    _condition.notify_all();
-    if (_main_thread.joinable()) {
-      _main_thread.join();
+    {
+      std::lock_guard<std::mutex> lock_park(_park_mutex);
+      _condition.notify_all();
+    }
+    for (auto &worker : _workers) {
+      if (worker.joinable()) {
+        worker.join();
+      }
     }
   }
 
@@ -0,0 +1,60 @@
+#include "consensus/ChainParameters.hpp"
+
+namespace neuro {
+namespace consensus {
+
+ChainParameters::ChainParameters(const messages::Block &block0,
+                                 const Config &config)
+    : _genesis_timestamp(block0.header().timestamp().data()),
+      _block_period(config.block_period),
+      _blocks_per_assembly(config.blocks_per_assembly) {}
+
+std::time_t ChainParameters::genesis_timestamp() const {
+  return _genesis_timestamp;
+}
+
+uint32_t ChainParameters::block_period() const { return _block_period; }
+
+uint32_t ChainParameters::blocks_per_assembly() const {
+  return _blocks_per_assembly;
+}
+
+std::time_t ChainParameters::slot_start(
+    const messages::BlockHeight height) const {
+  return _genesis_timestamp + static_cast<std::time_t>(height) * _block_period;
+}
+
+std::time_t ChainParameters::slot_end(
+    const messages::BlockHeight height) const {
+  return slot_start(height) + _block_period;
+}
+
+messages::BlockHeight ChainParameters::height_at(const std::time_t time) const {
+  return (time - _genesis_timestamp) / _block_period;
+}
+
+messages::BlockHeight ChainParameters::current_height() const {
+  return height_at(std::time(nullptr));
+}
+
+messages::AssemblyHeight ChainParameters::assembly_height(
+    const messages::BlockHeight height) const {
+  return height / _blocks_per_assembly;
+}
+
+messages::AssemblyHeight ChainParameters::current_assembly_height() const {
+  return assembly_height(current_height());
+}
+
+messages::BlockHeight ChainParameters::first_height(
+    const messages::AssemblyHeight assembly_height) const {
+  return assembly_height * _blocks_per_assembly;
+}
+
+messages::BlockHeight ChainParameters::last_height(
+    const messages::AssemblyHeight assembly_height) const {
+  return first_height(assembly_height + 1) - 1;
+}
+
+}  // namespace consensus
+}  // namespace neuro
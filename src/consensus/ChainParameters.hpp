@@ -0,0 +1,52 @@
+#ifndef NEURO_SRC_CONSENSUS_CHAINPARAMETERS_HPP
+#define NEURO_SRC_CONSENSUS_CHAINPARAMETERS_HPP
+
+#include <cstdint>
+#include <ctime>
+
+#include "consensus/Config.hpp"
+#include "messages.pb.h"
+#include "messages/Message.hpp"
+
+namespace neuro {
+namespace consensus {
+
+/**
+ * \brief Immutable parameters of the chain built once from the block0 and the
+ * consensus config
+ *
+ * It holds the slot clock: the block at height h must be written during
+ * [genesis_timestamp + h * block_period, genesis_timestamp + (h + 1) *
+ * block_period[. Use it instead of loading the block0 from the ledger.
+ */
+class ChainParameters {
+ private:
+  const std::time_t _genesis_timestamp;
+  const uint32_t _block_period;
+  const uint32_t _blocks_per_assembly;
+
+ public:
+  ChainParameters(const messages::Block &block0, const Config &config);
+
+  std::time_t genesis_timestamp() const;
+  uint32_t block_period() const;
+  uint32_t blocks_per_assembly() const;
+
+  std::time_t slot_start(const messages::BlockHeight height) const;
+  std::time_t slot_end(const messages::BlockHeight height) const;
+  messages::BlockHeight height_at(const std::time_t time) const;
+  messages::BlockHeight current_height() const;
+
+  messages::AssemblyHeight assembly_height(
+      const messages::BlockHeight height) const;
+  messages::AssemblyHeight current_assembly_height() const;
+  messages::BlockHeight first_height(
+      const messages::AssemblyHeight assembly_height) const;
+  messages::BlockHeight last_height(
+      const messages::AssemblyHeight assembly_height) const;
+};
+
+}  // namespace consensus
+}  // namespace neuro
+
+#endif /* NEURO_SRC_CONSENSUS_CHAINPARAMETERS_HPP */
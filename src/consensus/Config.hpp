@@ -16,11 +16,13 @@ struct Config {
   uint32_t max_transaction_per_block{300};
   std::chrono::seconds update_heights_sleep{5};
   std::chrono::seconds compute_pii_sleep{5};
-  std::chrono::milliseconds miner_sleep{100};
+  //! minimum time between two rebuilds of the next block for new transactions
+  std::chrono::milliseconds block_template_interval{500};
   int32_t integrity_block_reward{1};
   int32_t integrity_double_mining{-40};
   int32_t integrity_denunciation_reward{1};
   uint32_t default_transaction_expires{5760};
+  std::size_t transaction_cache_size{100000};
 };
 
 }  // namespace consensus
@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <algorithm>
+#include <chrono>
 #include <future>
 #include <random>
 #include <thread>
@@ -19,7 +21,8 @@ Consensus::Consensus(std::shared_ptr<ledger::Ledger> ledger,
     : _ledger(ledger),
       _keys(keys),
       _publish_block(publish_block),
-      _verified_block(verified_block) {
+      _verified_block(verified_block),
+      _transaction_cache(_config.transaction_cache_size) {
   init(start_threads);
 }
 
@@ -32,7 +35,8 @@ Consensus::Consensus(std::shared_ptr<ledger::Ledger> ledger,
       _ledger(ledger),
       _keys(keys),
       _publish_block(publish_block),
-      _verified_block(verified_block) {
+      _verified_block(verified_block),
+      _transaction_cache(_config.transaction_cache_size) {
   init(start_threads);
 }
 
@@ -44,7 +48,8 @@ Consensus::Consensus(std::shared_ptr<ledger::Ledger> ledger,
       _ledger(ledger),
       _keys(keys),
       _publish_block(publish_block),
-      _verified_block(verified_block) {
+      _verified_block(verified_block),
+      _transaction_cache(_config.transaction_cache_size) {
   init(start_threads);
 }
 
@@ -106,23 +111,34 @@ bool Consensus::check_signatures(
   return result;
 }
 
-bool Consensus::check_id(const messages::TaggedTransaction &tagged_transaction,
-                         const messages::TaggedBlock &tip) const {
-  auto transaction = messages::Transaction(tagged_transaction.transaction());
-  messages::set_transaction_hash(&transaction);
-  if (!tagged_transaction.transaction().has_id()) {
+bool Consensus::check_id_hash(
+    const messages::Transaction &transaction) const {
+  auto rehashed_transaction = messages::Transaction(transaction);
+  messages::set_transaction_hash(&rehashed_transaction);
+  if (!transaction.has_id()) {
     LOG_INFO << "Failed check_id the transaction has no id field";
     return false;
   }
-  if (transaction.id() != tagged_transaction.transaction().id()) {
-    LOG_INFO << "Failed check_id for transaction "
-             << tagged_transaction.transaction().id();
+  if (rehashed_transaction.id() != transaction.id()) {
+    LOG_INFO << "Failed check_id for transaction " << transaction.id();
     return false;
   }
+  return true;
+}
 
+bool Consensus::check_id(const messages::TaggedTransaction &tagged_transaction,
+                         const messages::TaggedBlock &tip) const {
+  return check_id_hash(tagged_transaction.transaction()) &&
+         check_unique_id(tagged_transaction, tip);
+}
+
+bool Consensus::check_unique_id(
+    const messages::TaggedTransaction &tagged_transaction,
+    const messages::TaggedBlock &tip) const {
   bool include_transaction_pool = !tagged_transaction.has_block_id();
-  auto transactions = _ledger->get_transactions(transaction.id(), tip,
-                                                include_transaction_pool);
+  auto transactions =
+      _ledger->get_transactions(tagged_transaction.transaction().id(), tip,
+                                include_transaction_pool);
   if (transactions.size() > 1) {
     LOG_INFO << "Failed check_id a transaction with the same id already exists";
     return false;
@@ -220,19 +236,41 @@ bool Consensus::check_block_id(
   return true;
 }
 
+LastSeenBlocks Consensus::get_last_seen_blocks(
+    const std::vector<messages::BlockID> &last_seen_block_ids) const {
+  LastSeenBlocks last_seen_blocks;
+  std::vector<messages::TaggedBlock> tagged_blocks;
+  bool include_transactions = false;
+  _ledger->get_blocks_by_ids(last_seen_block_ids, &tagged_blocks,
+                             include_transactions);
+  for (auto &tagged_block : tagged_blocks) {
+    const auto id = tagged_block.block().header().id().data();
+    last_seen_blocks.emplace(id, std::move(tagged_block));
+  }
+  return last_seen_blocks;
+}
+
 bool Consensus::is_unexpired(const messages::Transaction &transaction,
                              const messages::Block &block,
                              const messages::TaggedBlock &tip) const {
-  messages::TaggedBlock last_seen_block;
-  bool include_transactions = false;
-  if (!_ledger->get_block(transaction.last_seen_block_id(), &last_seen_block,
-                          include_transactions)) {
+  return is_unexpired(transaction, block, tip,
+                      get_last_seen_blocks({transaction.last_seen_block_id()}));
+}
+
+bool Consensus::is_unexpired(const messages::Transaction &transaction,
+                             const messages::Block &block,
+                             const messages::TaggedBlock &tip,
+                             const LastSeenBlocks &last_seen_blocks) const {
+  const auto it =
+      last_seen_blocks.find(transaction.last_seen_block_id().data());
+  if (it == last_seen_blocks.end()) {
     LOG_INFO << "Failed to get the last_seen_block with id "
              << transaction.last_seen_block_id()
              << " when checking if transaction " << transaction.id()
              << " is expired in block at height " << block.header().height();
     return false;
   }
+  const auto &last_seen_block = it->second;
   if (!_ledger->is_ancestor(last_seen_block.branch_path(), tip.branch_path())) {
     LOG_INFO << "The transaction is invalid because the last_seen_block_id "
              << transaction.last_seen_block_id()
@@ -260,9 +298,11 @@ bool Consensus::is_unexpired(const messages::Transaction &transaction,
 
 bool Consensus::is_block_transaction_valid(
     const messages::TaggedTransaction &tagged_transaction,
-    const messages::Block &block, const messages::TaggedBlock &tip) const {
+    const messages::Block &block, const messages::TaggedBlock &tip,
+    const LastSeenBlocks &last_seen_blocks) const {
   return is_valid(tagged_transaction, tip) &&
-         is_unexpired(tagged_transaction.transaction(), block, tip);
+         is_unexpired(tagged_transaction.transaction(), block, tip,
+                      last_seen_blocks);
 }
 
 bool Consensus::check_block_transactions(
@@ -274,11 +314,21 @@ bool Consensus::check_block_transactions(
     return false;
   }
 
+  // Most transactions of a block share a few recent last seen blocks
+  std::vector<messages::BlockID> last_seen_block_ids;
+  last_seen_block_ids.reserve(block.transactions_size() + 1);
+  last_seen_block_ids.push_back(block.coinbase().last_seen_block_id());
+  for (const auto &transaction : block.transactions()) {
+    last_seen_block_ids.push_back(transaction.last_seen_block_id());
+  }
+  const auto last_seen_blocks = get_last_seen_blocks(last_seen_block_ids);
+
   messages::TaggedTransaction tagged_coinbase;
   tagged_coinbase.set_is_coinbase(true);
   tagged_coinbase.mutable_block_id()->CopyFrom(block.header().id());
   tagged_coinbase.mutable_transaction()->CopyFrom(block.coinbase());
-  if (!is_block_transaction_valid(tagged_coinbase, block, tagged_block)) {
+  if (!is_block_transaction_valid(tagged_coinbase, block, tagged_block,
+                                  last_seen_blocks)) {
     LOG_INFO << "Failed check_block_transactions for block "
              << block.header().id();
     return false;
@@ -289,7 +339,8 @@ bool Consensus::check_block_transactions(
     tagged_transaction.set_is_coinbase(false);
     tagged_transaction.mutable_block_id()->CopyFrom(block.header().id());
     tagged_transaction.mutable_transaction()->CopyFrom(transaction);
-    if (!is_block_transaction_valid(tagged_transaction, block, tagged_block)) {
+    if (!is_block_transaction_valid(tagged_transaction, block, tagged_block,
+                                    last_seen_blocks)) {
       LOG_INFO << "Failed check_block_transactions for block "
                << block.header().id();
       return false;
@@ -358,10 +409,8 @@ bool Consensus::check_block_height(
 bool Consensus::check_block_timestamp(
     const messages::TaggedBlock &tagged_block) const {
   const auto &block = tagged_block.block();
-  messages::Block block0;
-  _ledger->get_block(0, &block0);
-  int64_t expected_timestamp = block0.header().timestamp().data() +
-                               block.header().height() * _config.block_period;
+  int64_t expected_timestamp =
+      _chain_parameters->slot_start(block.header().height());
   int64_t real_timestamp = tagged_block.block().header().timestamp().data();
   if (!block.header().has_timestamp()) {
     LOG_INFO << "Failed check_block_timestamp for block " << block.header().id()
@@ -491,6 +540,9 @@ messages::BlockScore Consensus::get_block_score(
 
 void Consensus::process_blocks() {
   std::lock_guard<std::mutex> lock(_process_blocks_mutex);
+  if (_is_process_blocks_stopped) {
+    return;
+  }
 
   // Use wait_for() with zero milliseconds to check thread status.
   if (_process_blocks_future.valid() &&
@@ -501,12 +553,41 @@ void Consensus::process_blocks() {
   _process_blocks_future = std::async(std::launch::async, [this]() {
     verify_blocks();
     _ledger->update_main_branch();
+
+    // The tip may have changed so the miner schedule may have changed too
+    if (_is_miner_running) {
+      update_heights_to_write();
+      set_block_template_dirty();
+    }
   });
 }
 
 bool Consensus::verify_blocks() {
+  bool result = true;
+
+  // Ids of the blocks marked as invalid during this pass, set_branch_invalid
+  // also marks all their descendants so there is no need to do it again
+  std::unordered_set<std::string> invalid_block_ids;
+  const auto set_branch_invalid = [&](const messages::Block &block) {
+    invalid_block_ids.insert(block.header().id().data());
+    if (!_ledger->set_branch_invalid(block.header().id())) {
+      throw std::runtime_error("Failed to mark a block as invalid");
+    }
+    LOG_WARNING << "Invalid block in verify_blocks " << block.header().id()
+                << " at height " << block.header().height();
+    result = false;
+  };
+
+  // The unverified blocks are sorted by height so a block always comes after
+  // its previous block
   auto tagged_blocks = _ledger->get_unverified_blocks();
   for (auto tagged_block : tagged_blocks) {
+    if (invalid_block_ids.count(
+            tagged_block.block().header().previous_block_hash().data()) > 0) {
+      // Already marked as invalid with its parent
+      invalid_block_ids.insert(tagged_block.block().header().id().data());
+      continue;
+    }
     _ledger->fill_block_transactions(tagged_block.mutable_block());
     messages::TaggedBlock previous;
     if (!_ledger->get_block(tagged_block.block().header().previous_block_hash(),
@@ -517,17 +598,8 @@ bool Consensus::verify_blocks() {
           messages::to_json(tagged_block.block().header().id()));
     }
     if (previous.branch() == messages::INVALID) {
-      if (!_ledger->set_branch_invalid(tagged_block.block().header().id())) {
-        throw std::runtime_error("Failed to mark a block as invalid");
-      } else {
-        LOG_WARNING << "Invalid block in verify_blocks "
-                    << tagged_block.block().header().id() << " at height "
-                    << tagged_block.block().header().height();
-
-        // The list of unverified blocks should have changed
-        verify_blocks();
-        return false;
-      }
+      set_branch_invalid(tagged_block.block());
+      continue;
     }
     if (previous.branch() == messages::UNVERIFIED) {
       // Probably because the assembly computations are not finished
@@ -538,7 +610,8 @@ bool Consensus::verify_blocks() {
     messages::Assembly previous_assembly, previous_previous_assembly;
     if (is_new_assembly(tagged_block, previous)) {
       const messages::AssemblyHeight height =
-          previous.block().header().height() / _config.blocks_per_assembly;
+          _chain_parameters->assembly_height(
+              previous.block().header().height());
       _ledger->add_assembly(previous, height);
       assembly_id = previous.block().header().id();
       if (!_ledger->get_assembly(previous.previous_assembly_id(),
@@ -583,31 +656,32 @@ bool Consensus::verify_blocks() {
       if (is_verified) {
         _verified_block(tagged_block.block());
       }
-    } else if (!_ledger->set_branch_invalid(
-                   tagged_block.block().header().id())) {
-      throw std::runtime_error("Failed to mark a block as invalid");
     } else {
-      // The list of unverified blocks should have changed
-      verify_blocks();
-      return false;
+      set_branch_invalid(tagged_block.block());
     }
   }
 
-  return true;
+  return result;
 }
 
 bool Consensus::is_new_assembly(const messages::TaggedBlock &tagged_block,
                                 const messages::TaggedBlock &previous) const {
-  auto block_assembly_height =
-      tagged_block.block().header().height() / _config.blocks_per_assembly;
+  auto block_assembly_height = _chain_parameters->assembly_height(
+      tagged_block.block().header().height());
   auto previous_assembly_height =
-      previous.block().header().height() / _config.blocks_per_assembly;
+      _chain_parameters->assembly_height(previous.block().header().height());
   return block_assembly_height != previous_assembly_height;
 }
 
 Config Consensus::config() const { return _config; }
 
 void Consensus::init(bool start_threads) {
+  messages::Block block0;
+  if (!_ledger->get_block(0, &block0)) {
+    throw std::runtime_error("Failed to get block0 in consensus init");
+  }
+  _chain_parameters = std::make_shared<const ChainParameters>(block0, _config);
+
   for (const auto &key : _keys) {
     _key_pubs.emplace_back(key.key_pub());
   }
@@ -626,8 +700,17 @@ Consensus::~Consensus() {
   LOG_DEBUG << this << " Entered consensus destructor";
   _is_compute_pii_stopped = true;
   _is_update_heights_stopped = true;
-  _is_miner_stopped = true;
+  stop_miner();
   _is_stopped_cv.notify_all();
+  {
+    // The processing in flight uses the ledger and wakes the miner up, it is
+    // waited before the threads are joined
+    std::lock_guard lock(_process_blocks_mutex);
+    _is_process_blocks_stopped = true;
+    if (_process_blocks_future.valid()) {
+      _process_blocks_future.wait();
+    }
+  }
   if (_compute_pii_thread.joinable()) {
     _compute_pii_thread.join();
   }
@@ -637,9 +720,6 @@ Consensus::~Consensus() {
   if (_miner_thread.joinable()) {
     _miner_thread.join();
   }
-  if (_process_blocks_future.valid()) {
-    _process_blocks_future.wait();
-  }
   LOG_DEBUG << this << " Leaving consensus destructor";
 }
 
@@ -649,10 +729,30 @@ bool Consensus::is_valid(const messages::TaggedTransaction &tagged_transaction,
     return check_id(tagged_transaction, tip) &&
            check_coinbase(tagged_transaction, tip);
   }
-  return check_id(tagged_transaction, tip) &&
-         check_signatures(tagged_transaction.transaction()) &&
-         check_double_inputs(tagged_transaction) &&
-         check_outputs(tagged_transaction.transaction());
+  return check_transaction(tagged_transaction) &&
+         check_unique_id(tagged_transaction, tip);
+}
+
+bool Consensus::check_transaction(
+    const messages::TaggedTransaction &tagged_transaction) const {
+  // Those checks do not depend on the tip so a transaction that passed them
+  // when entering the transaction pool does not need to be checked again
+  // when it is included in a block
+  const auto &transaction = tagged_transaction.transaction();
+  if (_transaction_cache.contains(transaction)) {
+    return true;
+  }
+  if (!check_id_hash(transaction) || !check_signatures(transaction) ||
+      !check_double_inputs(tagged_transaction) ||
+      !check_outputs(transaction)) {
+    return false;
+  }
+  _transaction_cache.insert(transaction);
+  return true;
+}
+
+const TransactionCache &Consensus::transaction_cache() const {
+  return _transaction_cache;
 }
 
 bool Consensus::is_valid(const messages::TaggedBlock &tagged_block) const {
@@ -676,9 +776,13 @@ bool Consensus::add_transaction(const messages::Transaction &transaction) {
   tagged_transaction.set_is_coinbase(false);
   tagged_transaction.mutable_transaction()->CopyFrom(transaction);
   const auto &tip = _ledger->get_main_branch_tip();
-  return is_valid(tagged_transaction, tip) &&
-         check_inputs(tagged_transaction.transaction(), tip) &&
-         _ledger->add_to_transaction_pool(transaction);
+  if (!is_valid(tagged_transaction, tip) ||
+      !check_inputs(tagged_transaction.transaction(), tip) ||
+      !_ledger->add_to_transaction_pool(transaction)) {
+    return false;
+  }
+  set_block_template_dirty();
+  return true;
 }
 
 bool Consensus::add_double_mining(const messages::Block &block) {
@@ -688,6 +792,7 @@ bool Consensus::add_double_mining(const messages::Block &block) {
                                     include_transactions);
   if (blocks.size() > 1) {
     _ledger->add_double_mining(blocks);
+    set_block_template_dirty();
   }
   return true;
 }
@@ -863,14 +968,15 @@ bool Consensus::get_block_writer(const messages::Assembly &assembly,
 }
 
 messages::BlockHeight Consensus::get_current_height() const {
-  messages::Block block0;
-  _ledger->get_block(0, &block0);
-  return (std::time(nullptr) - block0.header().timestamp().data()) /
-         _config.block_period;
+  return _chain_parameters->current_height();
 }
 
 messages::BlockHeight Consensus::get_current_assembly_height() const {
-  return get_current_height() / _config.blocks_per_assembly;
+  return _chain_parameters->current_assembly_height();
+}
+
+const ChainParameters &Consensus::chain_parameters() const {
+  return *_chain_parameters;
 }
 
 bool Consensus::get_heights_to_write(
@@ -905,11 +1011,11 @@ bool Consensus::get_heights_to_write(
   // I never want anyone to mine the block 0
   const int32_t current_height = std::max(get_current_height(), 1);
   const int32_t last_block_assembly_height =
-      last_block_height / _config.blocks_per_assembly;
+      _chain_parameters->assembly_height(last_block_height);
 
   int32_t first_height = last_block_height + 1;
   int32_t last_height =
-      (last_block_assembly_height + 1) * _config.blocks_per_assembly - 1;
+      _chain_parameters->last_height(last_block_assembly_height);
   for (int32_t i = std::max(current_height, first_height); i <= last_height;
        i++) {
     messages::_KeyPub writer;
@@ -925,12 +1031,11 @@ bool Consensus::get_heights_to_write(
     // If an assembly does not have any block then the assembly is repeated
     // until it does get a block
     int32_t current_assembly_height =
-        current_height / _config.blocks_per_assembly;
+        _chain_parameters->assembly_height(current_height);
     int32_t assembly_height_to_mine =
         std::max(current_assembly_height, last_block_assembly_height + 1);
-    first_height = assembly_height_to_mine * _config.blocks_per_assembly;
-    last_height =
-        (assembly_height_to_mine + 1) * _config.blocks_per_assembly - 1;
+    first_height = _chain_parameters->first_height(assembly_height_to_mine);
+    last_height = _chain_parameters->last_height(assembly_height_to_mine);
 
     for (auto i = std::max(current_height, first_height); i <= last_height;
          i++) {
@@ -957,11 +1062,18 @@ bool Consensus::cleanup_transactions(messages::Block *block) const {
     return false;
   }
 
+  std::vector<messages::BlockID> last_seen_block_ids;
+  last_seen_block_ids.reserve(block->transactions_size());
+  for (const auto &transaction : block->transactions()) {
+    last_seen_block_ids.push_back(transaction.last_seen_block_id());
+  }
+  const auto last_seen_blocks = get_last_seen_blocks(last_seen_block_ids);
+
   std::unordered_map<messages::_KeyPub, Double> balances;
   messages::Block accepted_transactions;
 
   for (const messages::Transaction &transaction : block->transactions()) {
-    if (!is_unexpired(transaction, *block, previous)) {
+    if (!is_unexpired(transaction, *block, previous, last_seen_blocks)) {
       _ledger->delete_transaction(transaction.id());
       continue;
     }
@@ -1009,9 +1121,9 @@ bool Consensus::cleanup_transactions(messages::Block *block) const {
   return true;
 }
 
-bool Consensus::build_block(const crypto::Ecc &keys,
-                            const messages::BlockHeight &height,
-                            messages::Block *block) const {
+bool Consensus::prepare_block(const crypto::Ecc &keys,
+                              const messages::BlockHeight &height,
+                              messages::Block *block) const {
   messages::TaggedBlock last_block = _ledger->get_main_branch_tip();
   auto &last_block_header = last_block.block().header();
   if (last_block_header.height() >= height) {
@@ -1023,7 +1135,6 @@ bool Consensus::build_block(const crypto::Ecc &keys,
   auto header = block->mutable_header();
   header->set_height(height);
   header->mutable_previous_block_hash()->CopyFrom(last_block_header.id());
-  header->mutable_timestamp()->set_data(std::time(nullptr));
 
   _ledger->get_transaction_pool(block, _config.max_block_size,
                                 _config.max_transaction_per_block);
@@ -1056,9 +1167,24 @@ bool Consensus::build_block(const crypto::Ecc &keys,
   _ledger->add_denunciations(block, last_block.branch_path());
 
   messages::sort_transactions(block);
+
+  return true;
+}
+
+void Consensus::finalize_block(const crypto::Ecc &keys,
+                               messages::Block *block) const {
+  block->mutable_header()->mutable_timestamp()->set_data(std::time(nullptr));
   messages::set_block_hash(block);
   crypto::sign(keys, block);
+}
 
+bool Consensus::build_block(const crypto::Ecc &keys,
+                            const messages::BlockHeight &height,
+                            messages::Block *block) const {
+  if (!prepare_block(keys, height, block)) {
+    return false;
+  }
+  finalize_block(keys, block);
   return true;
 }
 
@@ -1079,6 +1205,8 @@ void Consensus::start_update_heights_thread() {
 }
 
 void Consensus::update_heights_to_write() {
+  // Called both by the update heights thread and after processing blocks
+  std::lock_guard update_lock(_update_heights_mutex);
   messages::TaggedBlock tagged_block;
   bool include_transactions = false;
   if (!_ledger->get_last_block(&tagged_block, include_transactions)) {
@@ -1102,6 +1230,19 @@ void Consensus::update_heights_to_write() {
   if (_previous_assembly_id && _current_assembly_height &&
       _previous_assembly_id.value() == tagged_block.previous_assembly_id() &&
       _current_assembly_height == current_assembly_height) {
+    // The heights that are already in the ledger cannot be mined anymore
+    std::lock_guard lock(_heights_to_write_mutex);
+    const auto tip_height = tagged_block.block().header().height();
+    if (!_heights_to_write.empty() &&
+        _heights_to_write.front().first <= tip_height) {
+      _heights_to_write.erase(
+          _heights_to_write.begin(),
+          std::find_if(_heights_to_write.begin(), _heights_to_write.end(),
+                       [tip_height](const auto &height) {
+                         return height.first > tip_height;
+                       }));
+      _heights_to_write_cv.notify_all();
+    }
     return;
   }
 
@@ -1110,31 +1251,67 @@ void Consensus::update_heights_to_write() {
   _heights_to_write_mutex.lock();
   _heights_to_write = heights;
   _heights_to_write_mutex.unlock();
+  // Re-arm the miner on the first slot of the new schedule
+  _heights_to_write_cv.notify_all();
   _previous_assembly_id = tagged_block.previous_assembly_id();
   _current_assembly_height = current_assembly_height;
 }
 
 void Consensus::start_miner_thread() {
   if (!_miner_thread.joinable()) {
+    _is_miner_running = true;
     _miner_thread = std::thread([this]() { mine_blocks(); });
   }
 }
 
-bool Consensus::mine_block(const messages::Block &block0) {
-  std::lock_guard<std::mutex> lock(_heights_to_write_mutex);
-  if (_heights_to_write.empty()) {
-    return false;
+void Consensus::stop_miner() {
+  {
+    // Taking the lock makes sure the miner is either waiting or will see the
+    // flag before waiting
+    std::lock_guard lock(_heights_to_write_mutex);
+    _is_miner_stopped = true;
   }
-  const auto [height, key_pub_index] = _heights_to_write.front();
-  const auto block_start =
-      block0.header().timestamp().data() + height * _config.block_period;
-  const std::time_t block_end = block_start + _config.block_period;
-  const std::time_t current_time = std::time(nullptr);
+  _is_miner_running = false;
+  _heights_to_write_cv.notify_all();
+}
 
-  if (current_time < block_start) {
-    return false;
+void Consensus::set_block_template_dirty() {
+  // Only wake up the miner once per template rebuild
+  if (!_is_block_template_dirty.exchange(true)) {
+    _heights_to_write_cv.notify_all();
+  }
+}
+
+void Consensus::update_block_template(const messages::BlockHeight height,
+                                      const KeyPubIndex key_pub_index) {
+  const auto tip = _ledger->get_main_branch_tip();
+  if (_block_template && _block_template->height == height &&
+      _block_template->key_pub_index == key_pub_index &&
+      _block_template->block.header().previous_block_hash() ==
+          tip.block().header().id()) {
+    // Under load every transaction makes the template dirty, so it is only
+    // rebuilt once per block_template_interval for them
+    if (!_is_block_template_dirty ||
+        std::chrono::system_clock::now() <
+            _block_template_time + _config.block_template_interval) {
+      return;
+    }
+  }
+
+  _is_block_template_dirty = false;
+  _block_template_time = std::chrono::system_clock::now();
+  BlockTemplate block_template{height, key_pub_index, {}};
+  if (!prepare_block(_keys[key_pub_index], height, &block_template.block)) {
+    _block_template.reset();
+    return;
   }
-  _heights_to_write.erase(_heights_to_write.begin());
+  _block_template = std::move(block_template);
+}
+
+bool Consensus::mine_block(const messages::BlockHeight height,
+                           const KeyPubIndex key_pub_index) {
+  const std::time_t block_end = _chain_parameters->slot_end(height);
+  const std::time_t current_time = std::time(nullptr);
 
   if (current_time >= block_end) {
     return false;
@@ -1146,10 +1323,21 @@ bool Consensus::mine_block(const messages::Block &block0) {
     return false;
   }
 
+  // Use the template if it was prepared on top of the current tip, otherwise
+  // build the block from scratch
   messages::Block new_block;
-  if (!build_block(_keys[key_pub_index], height, &new_block)) {
+  const auto tip = _ledger->get_main_branch_tip();
+  if (_block_template && _block_template->height == height &&
+      _block_template->key_pub_index == key_pub_index &&
+      _block_template->block.header().previous_block_hash() ==
+          tip.block().header().id()) {
+    new_block.Swap(&_block_template->block);
+  } else if (!prepare_block(_keys[key_pub_index], height, &new_block)) {
+    _block_template.reset();
     return false;
   }
+  _block_template.reset();
+  finalize_block(_keys[key_pub_index], &new_block);
 
   // Check that the block author is correct
   messages::TaggedBlock tagged_block;
@@ -1189,23 +1377,60 @@ bool Consensus::mine_block(const messages::Block &block0) {
 }
 
 void Consensus::mine_blocks() {
-  messages::Block block0;
-  if (!_ledger->get_block(0, &block0)) {
-    throw std::runtime_error("Failed to get block0 in start_miner_thread");
-  }
+  // Instead of polling, sleep until the start of the slot of the first height
+  // to write. update_heights_to_write and stop_miner wake the miner up when
+  // the schedule changes, new transactions wake it up to refresh the block
+  // template.
+  std::unique_lock lock(_heights_to_write_mutex);
   while (!_is_miner_stopped) {
-    if (!mine_block(block0)) {
-      std::unique_lock cv_lock(_is_stopped_mutex);
-      _is_stopped_cv.wait_for(cv_lock, _config.miner_sleep,
-                              [&]() { return _is_miner_stopped; });
+    if (_heights_to_write.empty()) {
+      _heights_to_write_cv.wait(lock);
+      continue;
     }
+    const auto [height, key_pub_index] = _heights_to_write.front();
+    const auto block_start = std::chrono::system_clock::from_time_t(
+        _chain_parameters->slot_start(height));
+    if (std::chrono::system_clock::now() < block_start) {
+      // Prepare the block while waiting so that only the timestamp, the hash
+      // and the signature are left when the slot starts
+      lock.unlock();
+      update_block_template(height, key_pub_index);
+      lock.lock();
+      if (!_is_miner_stopped) {
+        // A dirty template is left as is until its rebuild interval is over
+        const auto wake_up =
+            _is_block_template_dirty
+                ? std::min<std::chrono::system_clock::time_point>(
+                      block_start,
+                      _block_template_time + _config.block_template_interval)
+                : block_start;
+        _heights_to_write_cv.wait_until(lock, wake_up);
+      }
+      continue;
+    }
+    _heights_to_write.erase(_heights_to_write.begin());
+
+    lock.unlock();
+    mine_block(height, key_pub_index);
+    lock.lock();
   }
 }
 
 void Consensus::cleanup_transaction_pool() {
   const auto &tip = _ledger->get_main_branch_tip();
+  // The cursor can only be read once, keep the pool to check it afterwards
+  std::vector<messages::TaggedTransaction> transaction_pool;
+  std::vector<messages::BlockID> last_seen_block_ids;
   for (const auto &tagged_transaction : _ledger->get_transaction_pool()) {
-    if (!is_unexpired(tagged_transaction.transaction(), tip.block(), tip) ||
+    last_seen_block_ids.push_back(
+        tagged_transaction.transaction().last_seen_block_id());
+    transaction_pool.push_back(tagged_transaction);
+  }
+  const auto last_seen_blocks = get_last_seen_blocks(last_seen_block_ids);
+
+  for (const auto &tagged_transaction : transaction_pool) {
+    if (!is_unexpired(tagged_transaction.transaction(), tip.block(), tip,
+                      last_seen_blocks) ||
         !check_inputs(tagged_transaction.transaction(), tip)) {
       _ledger->delete_transaction(tagged_transaction.transaction().id());
     }
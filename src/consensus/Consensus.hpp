@@ -8,13 +8,16 @@
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "common.pb.h"
 #include "consensus.pb.h"
+#include "consensus/ChainParameters.hpp"
 #include "consensus/Config.hpp"
 #include "consensus/Integrities.hpp"
 #include "consensus/Pii.hpp"
+#include "consensus/TransactionCache.hpp"
 #include "crypto/Ecc.hpp"
 #include "crypto/Sign.hpp"
 #include "ledger/Ledger.hpp"
@@ -24,6 +27,7 @@
 
 namespace neuro {
 namespace tooling {
+class ConsensusReplay;
 namespace tests {
 class RealtimeSimulator;
 }
@@ -39,25 +43,47 @@ class RealtimeConsensus;
 using PublishBlock = std::function<void(const messages::Block &block)>;
 using VerifiedBlock = std::function<void(const messages::Block &block)>;
 using KeyPubIndex = uint32_t;
+//! last seen blocks of transactions indexed by their id data
+using LastSeenBlocks = std::unordered_map<std::string, messages::TaggedBlock>;
 
 class Consensus {
  private:
+  //! block prepared in advance by the miner for its next height to write
+  struct BlockTemplate {
+    messages::BlockHeight height;
+    KeyPubIndex key_pub_index;
+    messages::Block block;
+  };
+
   const Config _config;
+  std::shared_ptr<const ChainParameters> _chain_parameters;
   std::shared_ptr<ledger::Ledger> _ledger;
   const std::vector<crypto::Ecc> &_keys;
   std::vector<messages::_KeyPub> _key_pubs;
   const PublishBlock _publish_block;
   const VerifiedBlock _verified_block;
+  mutable TransactionCache _transaction_cache;
   std::thread _compute_pii_thread;
+  //! heights to mine sorted by slot start, the miner sleeps until the first one
   std::vector<std::pair<messages::BlockHeight, KeyPubIndex>> _heights_to_write;
   messages::BlockHeight _last_mined_block_height = 0;  //!< cache for the last
   std::mutex _heights_to_write_mutex;
+  std::condition_variable _heights_to_write_cv;
+  std::mutex _update_heights_mutex;
+  std::optional<BlockTemplate> _block_template;  //!< only used by the miner
+  std::chrono::system_clock::time_point _block_template_time;
+  std::atomic<bool> _is_block_template_dirty{false};
   std::mutex _process_blocks_mutex;
   std::optional<messages::AssemblyID> _previous_assembly_id;
   std::optional<messages::AssemblyHeight> _current_assembly_height;
   std::thread _update_heights_thread;
   std::thread _miner_thread;
+  //! read by the blocks processing while the miner thread is started or
+  //! stopped
+  std::atomic<bool> _is_miner_running{false};
   std::future<void> _process_blocks_future;
+  //! guarded by _process_blocks_mutex, no processing starts once it is set
+  bool _is_process_blocks_stopped{false};
   std::condition_variable _is_stopped_cv;
   std::mutex _is_stopped_mutex;
   bool _is_miner_stopped;
@@ -70,9 +96,17 @@ class Consensus {
   bool check_signatures(
       const messages::Transaction &transaction) const;
 
+  bool check_id_hash(const messages::Transaction &transaction) const;
+
   bool check_id(const messages::TaggedTransaction &tagged_transaction,
                 const messages::TaggedBlock &tip) const;
 
+  bool check_unique_id(const messages::TaggedTransaction &tagged_transaction,
+                       const messages::TaggedBlock &tip) const;
+
+  bool check_transaction(
+      const messages::TaggedTransaction &tagged_transaction) const;
+
   bool check_double_inputs(
       const messages::TaggedTransaction &tagged_transaction) const;
 
@@ -84,14 +118,26 @@ class Consensus {
 
   bool check_block_id(const messages::TaggedBlock &tagged_block) const;
 
+  /**
+   * \brief Get the distinct last seen blocks of the transactions with a single
+   * ledger query
+   */
+  LastSeenBlocks get_last_seen_blocks(
+      const std::vector<messages::BlockID> &last_seen_block_ids) const;
+
   bool is_unexpired(const messages::Transaction &transaction,
                     const messages::Block &block,
                     const messages::TaggedBlock &tip) const;
 
+  bool is_unexpired(const messages::Transaction &transaction,
+                    const messages::Block &block,
+                    const messages::TaggedBlock &tip,
+                    const LastSeenBlocks &last_seen_blocks) const;
+
   bool is_block_transaction_valid(
       const messages::TaggedTransaction &tagged_transaction,
-      const messages::Block &block,
-      const messages::TaggedBlock &tagged_block) const;
+      const messages::Block &block, const messages::TaggedBlock &tagged_block,
+      const LastSeenBlocks &last_seen_blocks) const;
 
   bool check_block_transactions(
       const messages::TaggedBlock &tagged_block) const;
@@ -124,7 +170,15 @@ class Consensus {
   bool is_new_assembly(const messages::TaggedBlock &tagged_block,
                        const messages::TaggedBlock &previous) const;
 
-  bool mine_block(const messages::Block &block0);
+  bool mine_block(const messages::BlockHeight height,
+                  const KeyPubIndex key_pub_index);
+
+  void stop_miner();
+
+  void update_block_template(const messages::BlockHeight height,
+                             const KeyPubIndex key_pub_index);
+
+  void set_block_template_dirty();
 
   bool add_block(const messages::Block &block, bool async);
 
@@ -161,6 +215,8 @@ class Consensus {
 
   bool is_valid(const messages::TaggedBlock &tagged_block) const;
 
+  const TransactionCache &transaction_cache() const;
+
   /**
    * \brief Add transaction to transaction pool
    * \param [in] transaction
@@ -191,6 +247,7 @@ class Consensus {
 
   messages::BlockHeight get_current_height() const;
   messages::AssemblyHeight get_current_assembly_height() const;
+  const ChainParameters &chain_parameters() const;
 
   bool get_heights_to_write(
       const std::vector<messages::_KeyPub> &key_pubs,
@@ -199,6 +256,16 @@ class Consensus {
 
   bool cleanup_transactions(messages::Block *block) const;
 
+  /**
+   * \brief Fill everything in the block except the timestamp, the hash and the
+   * signature
+   */
+  bool prepare_block(const crypto::Ecc &keys,
+                     const messages::BlockHeight &height,
+                     messages::Block *block) const;
+
+  void finalize_block(const crypto::Ecc &keys, messages::Block *block) const;
+
   bool build_block(const crypto::Ecc &keys, const messages::BlockHeight &height,
                    messages::Block *block) const;
 
@@ -215,6 +282,7 @@ class Consensus {
   friend class neuro::consensus::tests::Consensus;
   friend class neuro::consensus::tests::RealtimeConsensus;
   friend class neuro::tooling::tests::RealtimeSimulator;
+  friend class neuro::tooling::ConsensusReplay;
 };
 
 }  // namespace consensus
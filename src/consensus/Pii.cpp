@@ -1,5 +1,9 @@
 #include <mpreal.h>
+#include <algorithm>
 #include <cstdint>
+#include <future>
+#include <numeric>
+#include <thread>
 
 #include "consensus/Pii.hpp"
 
@@ -141,33 +145,80 @@ std::vector<messages::_KeyPub> KeyPubs::key_pubs() const {
   return key_pubs;
 }
 
+std::string Pii::get_score(
+    const messages::_KeyPub &key_pub,
+    const messages::IntegrityScore &integrity_score) const {
+  auto entropy = _key_pubs.get_entropy(key_pub);
+
+  // TODO add a reference to a translated version of Dhaou's paper
+  Double divided_integrity = integrity_score / 2400;
+  auto integrity = 1 + 0.1 * divided_integrity / (1 + divided_integrity);
+  auto score = mpfr::fmax(1, integrity * entropy);
+  return score.toString();
+}
+
 std::vector<messages::Pii> Pii::get_key_pubs_pii(
     const messages::AssemblyHeight &assembly_height,
     const messages::BranchPath &branch_path) {
   std::lock_guard lock(mpfr_mutex);  // TODO trax, is it really needed?
+  const auto key_pubs = _key_pubs.key_pubs();
+
+  // We want to get the integrity at the assembly n - 1
+  const auto integrity_scores =
+      _ledger->get_integrities(key_pubs, assembly_height - 1, branch_path);
+
+  // The entropies are independent from each other so they are computed by
+  // chunks of key_pubs in parallel. Each worker only writes its own slots.
+  std::vector<std::string> scores(key_pubs.size());
+  const auto compute_scores = [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      scores[i] = get_score(key_pubs[i], integrity_scores[i]);
+    }
+  };
+  const std::size_t nb_workers = std::clamp<std::size_t>(
+      key_pubs.size() / MIN_KEY_PUBS_PER_WORKER, 1,
+      std::max(1u, std::thread::hardware_concurrency()));
+  if (nb_workers == 1) {
+    compute_scores(0, key_pubs.size());
+  } else {
+    const std::size_t chunk_size =
+        (key_pubs.size() + nb_workers - 1) / nb_workers;
+    std::vector<std::future<void>> workers;
+    for (std::size_t begin = 0; begin < key_pubs.size(); begin += chunk_size) {
+      const auto end = std::min(begin + chunk_size, key_pubs.size());
+      workers.push_back(
+          std::async(std::launch::async, [&compute_scores, begin, end]() {
+            compute_scores(begin, end);
+            // mpfr caches constants per thread
+            mpfr_free_cache();
+          }));
+    }
+    for (auto &worker : workers) {
+      worker.get();
+    }
+  }
+
+  // Sort indexes instead of the messages::Pii themselves. The order must not
+  // change: it is the order of the score strings and then of the raw_data,
+  // both in reverse order.
+  std::vector<std::size_t> order(key_pubs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    const int cmp = scores[a].compare(scores[b]);
+    if (cmp == 0) {
+      return key_pubs[a].raw_data() > key_pubs[b].raw_data();
+    }
+    // Sorted in reverse order
+    return cmp > 0;
+  });
+
   std::vector<messages::Pii> piis;
-  for (const auto &key_pub : _key_pubs.key_pubs()) {
+  piis.reserve(order.size());
+  for (const auto i : order) {
     auto &pii = piis.emplace_back();
-    auto entropy = _key_pubs.get_entropy(key_pub);
-
-    // We want to get the integrity at the assembly n - 1
-    // TODO add a reference to a translated version of Dhaou's paper
-    Double integrity_score =
-        _ledger->get_integrity(key_pub, assembly_height - 1, branch_path);
-    Double divided_integrity = integrity_score / 2400;
-    auto integrity = 1 + 0.1 * divided_integrity / (1 + divided_integrity);
-    auto score = mpfr::fmax(1, integrity * entropy);
-    pii.set_score(score.toString());
-    pii.mutable_key_pub()->CopyFrom(key_pub);
+    pii.set_score(std::move(scores[i]));
+    pii.mutable_key_pub()->CopyFrom(key_pubs[i]);
   }
-  std::sort(piis.begin(), piis.end(),
-            [](const messages::Pii &a, const messages::Pii &b) {
-              if (a.score() == b.score()) {
-                return a.key_pub().raw_data() > b.key_pub().raw_data();
-              }
-              // Sorted in reverse order
-              return a.score() > b.score();
-            });
   return piis;
 }
 
@@ -18,6 +18,9 @@ class Pii;
 
 const double NCC_SUBDIVISIONS = 1E9;
 
+// Below this number of key_pubs per thread the pii is computed sequentially
+const std::size_t MIN_KEY_PUBS_PER_WORKER = 256;
+
 using TotalSpent = std::unordered_map<messages::_KeyPub, messages::NCCValue>;
 using Balances = std::unordered_map<messages::_KeyPub, messages::Balance>;
 
@@ -66,6 +69,9 @@ class Pii {
   Double enthalpy_c() const;
   Double enthalpy_lambda() const;
 
+  std::string get_score(const messages::_KeyPub &key_pub,
+                        const messages::IntegrityScore &integrity_score) const;
+
  public:
   Pii(std::shared_ptr<ledger::Ledger> ledger, const consensus::Config &config)
       : _ledger(ledger), _config(config) {}
@@ -0,0 +1,63 @@
+#include "consensus/TransactionCache.hpp"
+
+namespace neuro {
+namespace consensus {
+
+TransactionCache::TransactionCache(std::size_t max_size)
+    : _max_size(max_size) {}
+
+bool TransactionCache::contains(const messages::Transaction &transaction) {
+  std::string serialized;
+  transaction.SerializePartialToString(&serialized);
+
+  std::lock_guard lock(_mutex);
+  const auto it = _entries_by_id.find(transaction.id().data());
+  if (it == _entries_by_id.end() || it->second->second != serialized) {
+    _misses++;
+    return false;
+  }
+  _entries.splice(_entries.begin(), _entries, it->second);
+  _hits++;
+  return true;
+}
+
+void TransactionCache::insert(const messages::Transaction &transaction) {
+  if (_max_size == 0) {
+    return;
+  }
+  std::string serialized;
+  transaction.SerializePartialToString(&serialized);
+  const auto &id = transaction.id().data();
+
+  std::lock_guard lock(_mutex);
+  const auto it = _entries_by_id.find(id);
+  if (it != _entries_by_id.end()) {
+    it->second->second = std::move(serialized);
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return;
+  }
+  _entries.emplace_front(id, std::move(serialized));
+  _entries_by_id[id] = _entries.begin();
+  if (_entries.size() > _max_size) {
+    _entries_by_id.erase(_entries.back().first);
+    _entries.pop_back();
+  }
+}
+
+std::size_t TransactionCache::size() const {
+  std::lock_guard lock(_mutex);
+  return _entries.size();
+}
+
+uint64_t TransactionCache::hits() const { return _hits; }
+
+uint64_t TransactionCache::misses() const { return _misses; }
+
+double TransactionCache::hit_rate() const {
+  const uint64_t hits = _hits;
+  const uint64_t total = hits + _misses;
+  return total == 0 ? 0 : static_cast<double>(hits) / total;
+}
+
+}  // namespace consensus
+}  // namespace neuro
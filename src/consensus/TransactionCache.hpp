@@ -0,0 +1,51 @@
+#ifndef NEURO_SRC_CONSENSUS_TRANSACTIONCACHE_HPP
+#define NEURO_SRC_CONSENSUS_TRANSACTIONCACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "messages.pb.h"
+
+namespace neuro {
+namespace consensus {
+
+/**
+ * \brief Bounded LRU of the transactions that passed the checks that do not
+ * depend on the tip (id hash, signatures, double inputs and outputs)
+ *
+ * Transactions are keyed by id but the whole serialized transaction is
+ * compared on lookup so that a transaction reusing a known id with a
+ * different content is checked again.
+ */
+class TransactionCache {
+ private:
+  using Entries = std::list<std::pair<std::string, std::string>>;
+
+  const std::size_t _max_size;
+  mutable std::mutex _mutex;
+  Entries _entries;  //!< (id, serialized transaction), most recent first
+  std::unordered_map<std::string, Entries::iterator> _entries_by_id;
+  std::atomic<uint64_t> _hits{0};
+  std::atomic<uint64_t> _misses{0};
+
+ public:
+  explicit TransactionCache(std::size_t max_size);
+
+  bool contains(const messages::Transaction &transaction);
+  void insert(const messages::Transaction &transaction);
+
+  std::size_t size() const;
+  uint64_t hits() const;
+  uint64_t misses() const;
+  double hit_rate() const;
+};
+
+}  // namespace consensus
+}  // namespace neuro
+
+#endif /* NEURO_SRC_CONSENSUS_TRANSACTIONCACHE_HPP */
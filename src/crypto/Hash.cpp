@@ -1,6 +1,9 @@
 
 #include "crypto/Hash.hpp"
 #include <cryptopp/sha3.h>
+#include <cryptopp/siphash.h>
+#include <algorithm>
+#include <cstring>
 
 #include "common/Buffer.hpp"
 #include "messages/Message.hpp"
@@ -26,5 +29,16 @@ Buffer hash_sha3_256(const messages::Packet &packet) {
   return hash_sha3_256(buffer);
 }
 
+uint64_t hash_siphash(std::string_view key, std::string_view data) {
+  CryptoPP::byte full_key[SIPHASH_KEY_SIZE] = {};
+  std::memcpy(full_key, key.data(), std::min(key.size(), SIPHASH_KEY_SIZE));
+  uint64_t digest;
+  CryptoPP::SipHash<2, 4>(full_key, SIPHASH_KEY_SIZE)
+      .CalculateDigest(reinterpret_cast<CryptoPP::byte *>(&digest),
+                       reinterpret_cast<const CryptoPP::byte *>(data.data()),
+                       data.size());
+  return digest;
+}
+
 }  // namespace crypto
 }  // namespace neuro
@@ -1,6 +1,9 @@
 #ifndef NEURO_SRC_CRYPTO_HASH_HPP
 #define NEURO_SRC_CRYPTO_HASH_HPP
 
+#include <cstdint>
+#include <string_view>
+
 #include "common/Buffer.hpp"
 #include "common/types.hpp"
 #include "messages/Message.hpp"
@@ -12,6 +15,15 @@ Buffer hash_sha3_256(const messages::Packet &packet);
 Buffer hash_sha3_256(const Buffer &data);
 void hash_sha3_256(const Buffer &data, Buffer *out);
 
+constexpr std::size_t SIPHASH_KEY_SIZE = 16;
+
+/**
+ * \brief Keyed 64 bits hash for the tables filled with data from the peers
+ * \param key only the first SIPHASH_KEY_SIZE bytes are used, the missing
+ * ones are 0
+ */
+uint64_t hash_siphash(std::string_view key, std::string_view data);
+
 }  // namespace crypto
 }  // namespace neuro
 
@@ -27,6 +27,16 @@ KeyPub::KeyPub(const Key &key) : _key(key) {
 
 KeyPub::Key *KeyPub::key() { return &_key; }
 
+void KeyPub::precompute() {
+  // The verifier holds its own copy of the key so the tables are computed on
+  // that copy
+  auto verifier = std::make_shared<Verifier>(_key);
+  verifier->AccessKey().Precompute();
+  _verifier = verifier;
+}
+
+bool KeyPub::is_precomputed() const { return _verifier != nullptr; }
+
 KeyPub::KeyPub(const uint8_t *data, const std::size_t size) {
   if (!load(data, size)) {
     throw std::runtime_error("Could not load key from raw buffer");
@@ -162,7 +172,12 @@ bool KeyPub::save_as_hex(messages::_KeyPub *key_pub) const {
 
 bool KeyPub::verify(const Buffer &data, const uint8_t *signature,
                     const std::size_t size) const {
-  CryptoPP::ECDSA<CryptoPP::ECP, CryptoPP::SHA256>::Verifier verifier(_key);
+  if (_verifier) {
+    return _verifier->VerifyMessage((const CryptoPP::byte *)data.data(),
+                                    data.size(),
+                                    (const CryptoPP::byte *)signature, size);
+  }
+  Verifier verifier(_key);
 
   return verifier.VerifyMessage((const CryptoPP::byte *)data.data(),
                                 data.size(), (const CryptoPP::byte *)signature,
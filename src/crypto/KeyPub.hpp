@@ -16,9 +16,12 @@ namespace crypto {
 class KeyPub : public messages::_KeyPub {
  public:
   using Key = CryptoPP::ECDSA<CryptoPP::ECP, CryptoPP::SHA256>::PublicKey;
+  using Verifier = CryptoPP::ECDSA<CryptoPP::ECP, CryptoPP::SHA256>::Verifier;
 
  private:
   Key _key;
+  //! built by precompute() for keys that verify many signatures
+  std::shared_ptr<const Verifier> _verifier;
   bool load(const Buffer &buffer);
   bool load(const Path &filepath);
   bool load(const uint8_t *data, const std::size_t size);
@@ -33,6 +36,13 @@ class KeyPub : public messages::_KeyPub {
   KeyPub(const uint8_t *data, const std::size_t size);
 
   Key *key();
+
+  /**
+   * \brief Precompute the verification tables of the key, it makes the
+   * construction more expensive but every verify() cheaper
+   */
+  void precompute();
+  bool is_precomputed() const;
   bool save(const Path &filepath) const;
   bool save(Buffer *buffer) const;
   Buffer save() const;
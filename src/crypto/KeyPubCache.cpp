@@ -0,0 +1,81 @@
+#include "crypto/KeyPubCache.hpp"
+
+namespace neuro {
+namespace crypto {
+
+KeyPubCache::KeyPubCache(std::size_t max_size)
+    : _max_size_per_shard((max_size + NB_SHARDS - 1) / NB_SHARDS) {}
+
+KeyPubCache &KeyPubCache::instance() {
+  static auto *key_pub_cache = new KeyPubCache();
+  return *key_pub_cache;
+}
+
+std::shared_ptr<const KeyPub> KeyPubCache::get(
+    const messages::_KeyPub &key_pub, bool is_reused) {
+  // The same key can be given as raw or hex data
+  const std::string key = key_pub.has_raw_data() ? "r" + key_pub.raw_data()
+                                                 : "h" + key_pub.hex_data();
+  auto &shard = _shards[std::hash<std::string>{}(key) % NB_SHARDS];
+  std::shared_ptr<const KeyPub> cached_key_pub;
+  {
+    std::lock_guard lock(shard.mutex);
+    const auto it = shard.entries_by_key.find(key);
+    if (it != shard.entries_by_key.end()) {
+      shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+      _hits++;
+      cached_key_pub = it->second->second;
+    }
+  }
+  if (cached_key_pub) {
+    if (cached_key_pub->is_precomputed()) {
+      return cached_key_pub;
+    }
+    // The key is used again, its tables are now worth it
+    auto precomputed_key_pub = std::make_shared<KeyPub>(*cached_key_pub);
+    precomputed_key_pub->precompute();
+    std::lock_guard lock(shard.mutex);
+    const auto it = shard.entries_by_key.find(key);
+    if (it != shard.entries_by_key.end() &&
+        it->second->second == cached_key_pub) {
+      it->second->second = precomputed_key_pub;
+    }
+    return precomputed_key_pub;
+  }
+
+  // Build the key outside of the lock, two threads may build the same key
+  _misses++;
+  auto new_key_pub = std::make_shared<KeyPub>(key_pub);
+  if (is_reused) {
+    new_key_pub->precompute();
+  }
+
+  std::lock_guard lock(shard.mutex);
+  const auto it = shard.entries_by_key.find(key);
+  if (it != shard.entries_by_key.end()) {
+    return it->second->second;
+  }
+  shard.entries.emplace_front(key, new_key_pub);
+  shard.entries_by_key[key] = shard.entries.begin();
+  if (shard.entries.size() > _max_size_per_shard) {
+    shard.entries_by_key.erase(shard.entries.back().first);
+    shard.entries.pop_back();
+  }
+  return new_key_pub;
+}
+
+std::size_t KeyPubCache::size() {
+  std::size_t size = 0;
+  for (auto &shard : _shards) {
+    std::lock_guard lock(shard.mutex);
+    size += shard.entries.size();
+  }
+  return size;
+}
+
+uint64_t KeyPubCache::hits() const { return _hits; }
+
+uint64_t KeyPubCache::misses() const { return _misses; }
+
+}  // namespace crypto
+}  // namespace neuro
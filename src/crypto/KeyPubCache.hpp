@@ -0,0 +1,74 @@
+#ifndef NEURO_SRC_CRYPTO_KEYPUBCACHE_HPP
+#define NEURO_SRC_CRYPTO_KEYPUBCACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "crypto/KeyPub.hpp"
+#include "messages.pb.h"
+
+namespace neuro {
+namespace crypto {
+
+/**
+ * \brief Bounded LRU of the keys built from their protobuf
+ *
+ * Building a KeyPub decompresses the point. The verification tables cost more
+ * than a single verification, so they are only precomputed for the keys that
+ * are used again or that are known to be reused, like the keys of the peers.
+ * The cache is split in shards with their own lock so that threads verifying
+ * signatures do not wait on each other.
+ */
+class KeyPubCache {
+ public:
+  static constexpr std::size_t NB_SHARDS = 16;
+  static constexpr std::size_t DEFAULT_MAX_SIZE = 16384;
+
+ private:
+  using Entries =
+      std::list<std::pair<std::string, std::shared_ptr<const KeyPub>>>;
+
+  struct Shard {
+    std::mutex mutex;
+    Entries entries;  //!< most recent first
+    std::unordered_map<std::string, Entries::iterator> entries_by_key;
+  };
+
+  const std::size_t _max_size_per_shard;
+  std::array<Shard, NB_SHARDS> _shards;
+  std::atomic<uint64_t> _hits{0};
+  std::atomic<uint64_t> _misses{0};
+
+ public:
+  explicit KeyPubCache(std::size_t max_size = DEFAULT_MAX_SIZE);
+
+  /**
+   * \brief Cache shared by the whole process, it is never destroyed so that
+   * signatures can be checked by threads still running at exit
+   */
+  static KeyPubCache &instance();
+
+  /**
+   * \brief Get the key from the cache or build it
+   * \param is_reused precompute the key on its first use, otherwise it is
+   * precomputed when it is used again
+   * \throw std::runtime_error if the key cannot be loaded
+   */
+  std::shared_ptr<const KeyPub> get(const messages::_KeyPub &key_pub,
+                                    bool is_reused = false);
+
+  std::size_t size();
+  uint64_t hits() const;
+  uint64_t misses() const;
+};
+
+}  // namespace crypto
+}  // namespace neuro
+
+#endif /* NEURO_SRC_CRYPTO_KEYPUBCACHE_HPP */
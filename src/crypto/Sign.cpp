@@ -3,6 +3,7 @@
 #include "common/Buffer.hpp"
 #include "common/logger.hpp"
 #include "crypto/KeyPriv.hpp"
+#include "crypto/KeyPubCache.hpp"
 
 namespace neuro {
 namespace crypto {
@@ -48,12 +49,12 @@ bool verify(const messages::Transaction &transaction) {
   for (const auto &input : transaction.inputs()) {
     const auto signature = input.signature();
 
-    KeyPub key_pub(input.key_pub());
+    const auto key_pub = KeyPubCache::instance().get(input.key_pub());
 
     const auto hash = signature.data();
     const Buffer sig(hash.data(), hash.size());
 
-    if (!key_pub.verify(buffer, sig)) {
+    if (!key_pub->verify(buffer, sig)) {
       LOG_WARNING << "Wrong signature in transaction " << transaction;
       return false;
     }
@@ -100,9 +101,9 @@ bool verify(const messages::Denunciation &denunciation) {
   const auto hash = author.signature().data();
   const Buffer sig(hash.data(), hash.size());
 
-  KeyPub key_pub(author.key_pub());
+  const auto key_pub = KeyPubCache::instance().get(author.key_pub());
 
-  if (!key_pub.verify(buffer, sig)) {
+  if (!key_pub->verify(buffer, sig)) {
     LOG_WARNING << "Wrong signature in denunciation with block id "
                 << denunciation.block_id();
     return false;
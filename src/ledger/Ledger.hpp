@@ -222,6 +222,10 @@ class Ledger {
       const messages::BlockID &previd,
       std::vector<messages::TaggedBlock> *tagged_blocks,
       bool include_transactions = true) const = 0;
+  virtual bool get_blocks_by_ids(
+      const std::vector<messages::BlockID> &ids,
+      std::vector<messages::TaggedBlock> *tagged_blocks,
+      bool include_transactions = true) const = 0;
   virtual bool get_block(const messages::BlockHeight height,
                          messages::Block *block,
                          bool include_transactions = true) const = 0;
@@ -289,10 +293,19 @@ class Ledger {
 
   virtual Cursor<messages::TaggedBlock> get_unverified_blocks() const = 0;
 
+  /**
+   * \brief Set the score of a block and make it a tip candidate
+   * \return false if the block does not exist or was already verified with
+   * the same score and assembly
+   */
   virtual bool set_block_verified(
       const messages::BlockID &id, const messages::BlockScore &score,
       const messages::AssemblyID previous_assembly_id) = 0;
 
+  /**
+   * \brief Tag MAIN the branch of the valid block with the best score, on
+   * equal scores the block verified first is kept
+   */
   virtual bool update_main_branch() = 0;
 
   virtual bool get_assembly_piis(const messages::AssemblyID &assembly_id,
@@ -326,6 +339,15 @@ class Ledger {
       const messages::AssemblyHeight &assembly_height,
       const messages::BranchPath &branch_path) const = 0;
 
+  /**
+   * \brief Same as get_integrity but for several key_pubs in a single query
+   * \return the integrity scores in the same order as key_pubs
+   */
+  virtual std::vector<messages::IntegrityScore> get_integrities(
+      const std::vector<messages::_KeyPub> &key_pubs,
+      const messages::AssemblyHeight &assembly_height,
+      const messages::BranchPath &branch_path) const = 0;
+
   virtual bool set_previous_assembly_id(
       const messages::BlockID &block_id,
       const messages::AssemblyID &previous_assembly_id) = 0;
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <mpreal.h>
+#include <unordered_set>
 
 #include "bsoncxx/builder/basic/array.hpp"
 #include "bsoncxx/builder/stream/document.hpp"
@@ -16,6 +17,8 @@ const std::string DETACHED_BRANCH_NAME =
     messages::Branch_Name(messages::Branch::DETACHED);
 const std::string FORK_BRANCH_NAME =
     messages::Branch_Name(messages::Branch::FORK);
+const std::string INVALID_BRANCH_NAME =
+    messages::Branch_Name(messages::Branch::INVALID);
 const std::string MAIN_BRANCH_NAME =
     messages::Branch_Name(messages::Branch::MAIN);
 const std::string UNVERIFIED_BRANCH_NAME =
@@ -27,6 +30,7 @@ const std::string $EXISTS = "$exists";
 const std::string $ELEMMATCH = "$elemMatch";
 const std::string $IN = "$in";
 const std::string $LTE = "$lte";
+const std::string $NE = "$ne";
 const std::string $OR = "$or";
 const std::string $SET = "$set";
 const std::string AS = "as";
@@ -43,10 +47,13 @@ const std::string BLOCKS = "blocks";
 const std::string BRANCH = "branch";
 const std::string BRANCH_IDS = "branchIds";
 const std::string BRANCH_PATH = "branchPath";
+const std::string CONNECT_FROM_FIELD = "connectFromField";
+const std::string CONNECT_TO_FIELD = "connectToField";
 const std::string COUNT = "count";
 const std::string DATA = "data";
 const std::string DOUBLE_MINING = "doubleMining";
 const std::string DENUNCIATIONS = "denunciations";
+const std::string DESCENDANTS = "descendants";
 const std::string FEES = "fees";
 const std::string FINISHED_COMPUTATION = "finishedComputation";
 const std::string FROM = "from";
@@ -68,6 +75,7 @@ const std::string PREVIOUS_BLOCK_HASH = "previousBlockHash";
 const std::string RANK = "rank";
 const std::string SCORE = "score";
 const std::string SEED = "seed";
+const std::string START_WITH = "startWith";
 const std::string TAGGED_BLOCK = "taggedBlock";
 const std::string TRANSACTION = "transaction";
 const std::string TRANSACTIONS = "transactions";
@@ -279,7 +287,10 @@ void LedgerMongodb::create_indexes() {
                                     << bss::finalize);
   _pii.create_index(bss::document{} << RANK << 1 << ASSEMBLY_ID << 1
                                     << bss::finalize);
-  _integrity.create_index(bss::document{} << KEY_PUB << 1 << bss::finalize);
+  // Follows the sort of the integrity queries so mongo does not sort them in
+  // memory
+  _integrity.create_index(bss::document{} << KEY_PUB << 1 << BLOCK_HEIGHT
+                                          << -1 << bss::finalize);
   _assemblies.create_index(bss::document{} << ID << 1 << bss::finalize);
   _assemblies.create_index(bss::document{} << PREVIOUS_ASSEMBLY_ID << 1
                                            << bss::finalize);
@@ -314,6 +325,8 @@ void LedgerMongodb::init_database(const messages::Block &block0) {
 
 void LedgerMongodb::remove_all() {
   std::lock_guard lock(_ledger_mutex);
+  reset_tip_candidates();
+  _main_branch_tip.Clear();
   _blocks.delete_many(bss::document{} << bss::finalize);
   _transactions.delete_many(bss::document{} << bss::finalize);
   _pii.delete_many(bss::document{} << bss::finalize);
@@ -579,6 +592,39 @@ bool LedgerMongodb::get_blocks_by_previd(
   return true;
 }
 
+bool LedgerMongodb::get_blocks_by_ids(
+    const std::vector<messages::BlockID> &ids,
+    std::vector<messages::TaggedBlock> *tagged_blocks,
+    bool include_transactions) const {
+  std::lock_guard lock(_ledger_mutex);
+  std::unordered_set<std::string> unique_ids;
+  bsoncxx::builder::basic::array bson_ids;
+  for (const auto &id : ids) {
+    if (unique_ids.insert(id.data()).second) {
+      bson_ids.append(to_bson(id));
+    }
+  }
+  if (unique_ids.empty()) {
+    return false;
+  }
+
+  auto query = bss::document{} << BLOCK + "." + HEADER + "." + ID
+                               << bss::open_document << $IN << bson_ids
+                               << bss::close_document << bss::finalize;
+  auto cursor = _blocks.find(std::move(query), remove_balances());
+
+  bool found = false;
+  for (const auto &bson_block : cursor) {
+    auto &tagged_block = tagged_blocks->emplace_back();
+    from_bson(bson_block, &tagged_block);
+    if (include_transactions) {
+      fill_block_transactions(tagged_block.mutable_block());
+    }
+    found = true;
+  }
+  return found;
+}
+
 bool LedgerMongodb::get_block(const messages::BlockHeight height,
                               messages::Block *block,
                               bool include_transactions) const {
@@ -705,6 +751,12 @@ bool LedgerMongodb::delete_block(const messages::BlockID &id) {
   auto result = _blocks.delete_one(std::move(delete_block_query));
   bool did_delete = result && result->deleted_count() > 0;
   if (did_delete) {
+    reset_tip_candidates();
+    if (_main_branch_tip.has_block() &&
+        _main_branch_tip.block().header().id() == id) {
+      _main_branch_tip.Clear();
+      set_main_branch_tip();
+    }
     auto delete_transaction_query = bss::document{} << BLOCK_ID << to_bson(id)
                                                     << bss::finalize;
     auto res_transaction =
@@ -731,16 +783,53 @@ bool LedgerMongodb::delete_block_and_children(const messages::BlockID &id) {
 
 bool LedgerMongodb::set_branch_invalid(const messages::BlockID &id) {
   std::lock_guard lock(_ledger_mutex);
-  std::vector<messages::TaggedBlock> tagged_blocks;
-  get_blocks_by_previd(id, &tagged_blocks);
-  bool result = true;
-  for (const auto &tagged_block : tagged_blocks) {
-    result &= set_branch_invalid(tagged_block.block().header().id());
+  LOG_DEBUG << "Updating branch tag of block " << id
+            << " and its descendants to "
+            << Branch_Name(messages::Branch::INVALID);
+
+  // Get the ids of all the descendants of the block in a single aggregation
+  // instead of walking the tree one generation at a time
+  const auto block_id_field = BLOCK + "." + HEADER + "." + ID;
+  auto match = bss::document{} << block_id_field << to_bson(id)
+                               << bss::finalize;
+  auto graph_lookup = bss::document{}
+                      << FROM << BLOCKS << START_WITH << "$" + block_id_field
+                      << CONNECT_FROM_FIELD << block_id_field
+                      << CONNECT_TO_FIELD
+                      << BLOCK + "." + HEADER + "." + PREVIOUS_BLOCK_HASH << AS
+                      << DESCENDANTS << bss::finalize;
+  auto project = bss::document{} << DESCENDANTS + "." + block_id_field << 1
+                                 << bss::finalize;
+  mongocxx::pipeline pipeline;
+  pipeline.match(match.view());
+  pipeline.graph_lookup(graph_lookup.view());
+  pipeline.project(project.view());
+  auto cursor = _blocks.aggregate(pipeline);
+  const auto bson_block = cursor.begin();
+  if (bson_block == cursor.end()) {
+    return false;
   }
-  if (result) {
-    result &= update_branch_tag(id, messages::Branch::INVALID);
+
+  bsoncxx::builder::basic::array bson_ids;
+  bson_ids.append(to_bson(id));
+  for (const auto &descendant : (*bson_block)[DESCENDANTS].get_array().value) {
+    bson_ids.append(descendant[BLOCK][HEADER][ID].get_document());
   }
-  return result;
+
+  auto filter = bss::document{} << block_id_field << bss::open_document << $IN
+                                << bson_ids << bss::close_document
+                                << bss::finalize;
+  auto update = bss::document{}
+                << $SET << bss::open_document << BRANCH
+                << messages::Branch_Name(messages::Branch::INVALID)
+                << bss::close_document << bss::finalize;
+  auto update_result =
+      _blocks.update_many(std::move(filter), std::move(update));
+
+  // Invalid blocks can no longer be the best tip, this is rare enough that
+  // the candidates are simply reloaded
+  reset_tip_candidates();
+  return update_result && update_result->matched_count() > 0;
 }
 
 bool LedgerMongodb::get_transaction(
@@ -1184,7 +1273,6 @@ bool LedgerMongodb::set_block_verified(
     const messages::BlockID &id, const messages::BlockScore &score,
     const messages::AssemblyID previous_assembly_id) {
   std::lock_guard lock(_ledger_mutex);
-  messages::TaggedBlock previous;
   auto filter = bss::document{} << BLOCK + "." + HEADER + "." + ID
                                 << to_bson(id) << bss::finalize;
   auto update = bss::document{}
@@ -1192,8 +1280,88 @@ bool LedgerMongodb::set_block_verified(
                 << FORK_BRANCH_NAME << PREVIOUS_ASSEMBLY_ID
                 << to_bson(previous_assembly_id) << bss::close_document
                 << bss::finalize;
-  auto update_result = _blocks.update_one(std::move(filter), std::move(update));
-  return update_result && update_result->modified_count() > 0;
+  auto update_result = _blocks.update_one(filter.view(), std::move(update));
+  if (!update_result || update_result->modified_count() == 0) {
+    // Already verified with the same score, the candidates are up to date
+    return false;
+  }
+
+  mongocxx::options::find options;
+  options.projection(bss::document{}
+                     << _ID << 0 << BLOCK + "." + HEADER + "." +
+                                        PREVIOUS_BLOCK_HASH
+                     << 1 << bss::finalize);
+  auto bson_block = _blocks.find_one(filter.view(), options);
+  if (!bson_block) {
+    return false;
+  }
+
+  // The previous block is not a leaf anymore
+  const auto bson_previous_id =
+      bson_block->view()[BLOCK][HEADER][PREVIOUS_BLOCK_HASH];
+  if (bson_previous_id) {
+    messages::BlockID previous_id;
+    from_bson(bson_previous_id.get_document().view(), &previous_id);
+    remove_tip_candidate(previous_id);
+  }
+  add_tip_candidate(id, score);
+  return true;
+}
+
+void LedgerMongodb::add_tip_candidate(const messages::BlockID &id,
+                                      const messages::BlockScore &score) {
+  std::lock_guard lock(_ledger_mutex);
+  if (!_is_tip_candidates_loaded) {
+    // get_best_tip_candidate will load the best block from the database
+    return;
+  }
+  remove_tip_candidate(id);
+  // For the same score the block verified first wins
+  const auto key = std::make_pair(score, -_tip_candidates_order++);
+  _tip_candidates.emplace(key, id);
+  _tip_candidates_keys.emplace(id.data(), key);
+}
+
+void LedgerMongodb::remove_tip_candidate(const messages::BlockID &id) {
+  std::lock_guard lock(_ledger_mutex);
+  const auto it = _tip_candidates_keys.find(id.data());
+  if (it == _tip_candidates_keys.end()) {
+    return;
+  }
+  _tip_candidates.erase(it->second);
+  _tip_candidates_keys.erase(it);
+}
+
+void LedgerMongodb::reset_tip_candidates() {
+  std::lock_guard lock(_ledger_mutex);
+  _tip_candidates.clear();
+  _tip_candidates_keys.clear();
+  _is_tip_candidates_loaded = false;
+}
+
+bool LedgerMongodb::get_best_tip_candidate(messages::BlockID *id) {
+  std::lock_guard lock(_ledger_mutex);
+  if (!_is_tip_candidates_loaded) {
+    // The invalid blocks keep their score but cannot be the tip
+    auto query = bss::document{} << BRANCH << bss::open_document << $NE
+                                 << INVALID_BRANCH_NAME << bss::close_document
+                                 << bss::finalize;
+    auto options = remove_balances();
+    options.sort(bss::document{} << SCORE << -1 << bss::finalize);
+    auto bson_block = _blocks.find_one(std::move(query), options);
+    if (!bson_block) {
+      return false;
+    }
+    messages::TaggedBlock best_block;
+    from_bson(bson_block->view(), &best_block);
+    _is_tip_candidates_loaded = true;
+    add_tip_candidate(best_block.block().header().id(), best_block.score());
+  }
+  if (_tip_candidates.empty()) {
+    return false;
+  }
+  id->CopyFrom(_tip_candidates.rbegin()->second);
+  return true;
 }
 
 bool LedgerMongodb::update_branch_tag(const messages::BlockID &id,
@@ -1239,14 +1407,11 @@ bool LedgerMongodb::cleanup_transaction_pool(
 bool LedgerMongodb::update_main_branch() {
   std::lock_guard lock(_ledger_mutex);
   messages::TaggedBlock main_branch_tip;
-  auto query = bss::document{} << bss::finalize;
-  auto options = remove_balances();
-  options.sort(bss::document{} << SCORE << -1 << bss::finalize);
-  auto bson_block = _blocks.find_one(std::move(query), options);
-  if (!bson_block) {
+  messages::BlockID main_branch_tip_id;
+  if (!get_best_tip_candidate(&main_branch_tip_id) ||
+      !get_block(main_branch_tip_id, &main_branch_tip, false)) {
     return false;
   }
-  from_bson(bson_block->view(), &main_branch_tip);
 
   //  assert(main_branch_tip.branch() != messages::Branch::DETACHED);
   if (main_branch_tip.branch() == messages::Branch::MAIN) {
@@ -1319,6 +1484,8 @@ bool LedgerMongodb::get_pii(const messages::_KeyPub &key_pub,
 
 void LedgerMongodb::empty_database() {
   std::lock_guard lock(_ledger_mutex);
+  reset_tip_candidates();
+  _main_branch_tip.Clear();
   _db.drop();
 }
 
@@ -1484,6 +1651,64 @@ messages::IntegrityScore LedgerMongodb::get_integrity(
   return 0;
 }
 
+std::vector<messages::IntegrityScore> LedgerMongodb::get_integrities(
+    const std::vector<messages::_KeyPub> &key_pubs,
+    const messages::AssemblyHeight &assembly_height,
+    const messages::BranchPath &branch_path) const {
+  std::lock_guard lock(_ledger_mutex);
+  std::vector<messages::IntegrityScore> scores(key_pubs.size(), 0);
+  std::unordered_map<messages::_KeyPub, std::size_t> indexes;
+  bsoncxx::builder::basic::array bson_key_pubs;
+  for (std::size_t i = 0; i < key_pubs.size(); i++) {
+    if (indexes.emplace(key_pubs[i], i).second) {
+      bson_key_pubs.append(to_bson(key_pubs[i]));
+    }
+  }
+  if (indexes.empty()) {
+    return scores;
+  }
+
+  auto query = bss::document{} << KEY_PUB << bss::open_document << $IN
+                               << bson_key_pubs << bss::close_document
+                               << ASSEMBLY_HEIGHT << bss::open_document << $LTE
+                               << assembly_height << bss::close_document
+                               << bss::finalize;
+  // Sorted along the {keyPub, blockHeight} index, sorting only by block height
+  // would sort the integrities of all the key_pubs in memory
+  auto options = remove_OID();
+  options.sort(bss::document{} << KEY_PUB << 1 << BLOCK_HEIGHT << -1
+                               << bss::finalize);
+  auto cursor = _integrity.find(std::move(query), options);
+
+  // Same logic as get_integrity: for each key_pub keep the first integrity
+  // (highest block height) that is in our branch
+  std::unordered_set<messages::_KeyPub> found;
+  for (const auto bson_integrity : cursor) {
+    messages::Integrity integrity;
+    from_bson(bson_integrity, &integrity);
+    const auto &key_pub = integrity.key_pub();
+    if (found.count(key_pub) > 0) {
+      continue;
+    }
+    const auto it = indexes.find(key_pub);
+    if (it == indexes.end() ||
+        !is_ancestor(integrity.branch_path(), branch_path)) {
+      continue;
+    }
+    scores[it->second] = messages::IntegrityScore(integrity.score());
+    found.insert(key_pub);
+    if (found.size() == indexes.size()) {
+      break;
+    }
+  }
+
+  // Duplicated key_pubs get the same score as their first occurrence
+  for (std::size_t i = 0; i < key_pubs.size(); i++) {
+    scores[i] = scores[indexes.at(key_pubs[i])];
+  }
+  return scores;
+}
+
 bool LedgerMongodb::get_assemblies_to_compute(
     std::vector<messages::Assembly> *assemblies) const {
   std::lock_guard lock(_ledger_mutex);
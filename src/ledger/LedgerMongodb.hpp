@@ -4,7 +4,9 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <cstdint>
+#include <map>
 #include <mutex>
+#include <unordered_map>
 
 #include "bsoncxx/document/view_or_value.hpp"
 #include "common.pb.h"
@@ -117,6 +119,16 @@ class LedgerMongodb : public Ledger {
 
   messages::TaggedBlock _main_branch_tip;
 
+  //! Verified blocks that can be the best tip sorted by score and then by
+  //! reverse verification order, the best one is the last. Loaded lazily from
+  //! the database and then kept up to date by set_block_verified.
+  std::map<std::pair<messages::BlockScore, int64_t>, messages::BlockID>
+      _tip_candidates;
+  std::unordered_map<std::string, std::pair<messages::BlockScore, int64_t>>
+      _tip_candidates_keys;  //!< by block id data
+  int64_t _tip_candidates_order = 0;
+  bool _is_tip_candidates_loaded = false;
+
   static mongocxx::options::find remove_OID();
 
   static mongocxx::options::find remove_balances();
@@ -153,6 +165,15 @@ class LedgerMongodb : public Ledger {
 
   void create_indexes();
 
+  void add_tip_candidate(const messages::BlockID &id,
+                         const messages::BlockScore &score);
+
+  void remove_tip_candidate(const messages::BlockID &id);
+
+  void reset_tip_candidates();
+
+  bool get_best_tip_candidate(messages::BlockID *id);
+
   void create_first_assemblies(const std::vector<messages::_KeyPub> &key_pubs);
 
   bool cleanup_transaction_pool(const messages::BlockID &block_id);
@@ -220,6 +241,15 @@ class LedgerMongodb : public Ledger {
                             std::vector<messages::TaggedBlock> *tagged_blocks,
                             bool include_transactions = true) const;
 
+  /**
+   * \brief Get the blocks with the given ids in a single query, ids that are
+   * not found are skipped and duplicated ids are returned once
+   * \return false if no block was found
+   */
+  bool get_blocks_by_ids(const std::vector<messages::BlockID> &ids,
+                         std::vector<messages::TaggedBlock> *tagged_blocks,
+                         bool include_transactions = true) const;
+
   bool get_block(const messages::BlockHeight height, messages::Block *block,
                  bool include_transactions = true) const;
 
@@ -321,6 +351,11 @@ class LedgerMongodb : public Ledger {
       const messages::AssemblyHeight &assembly_height,
       const messages::BranchPath &branch_path) const;
 
+  std::vector<messages::IntegrityScore> get_integrities(
+      const std::vector<messages::_KeyPub> &key_pubs,
+      const messages::AssemblyHeight &assembly_height,
+      const messages::BranchPath &branch_path) const;
+
   bool add_integrity(const messages::_KeyPub &key_pub,
                      const messages::AssemblyID &assembly_id,
                      const messages::AssemblyHeight &assembly_height,
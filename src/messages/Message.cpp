@@ -1,4 +1,10 @@
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/unknown_field_set.h>
 #include <google/protobuf/util/json_util.h>
+#include <memory>
+#include <vector>
 
 #include "common/logger.hpp"
 #include "messages/Hasher.hpp"
@@ -55,6 +61,82 @@ bool to_buffer(const Packet &packet, Buffer *buffer) {
   }
 }
 
+namespace {
+
+bool has_unknown_fields(const Packet &packet) {
+  const auto reflection = packet.GetReflection();
+  if (!reflection->GetUnknownFields(packet).empty()) {
+    return true;
+  }
+  std::vector<const google::protobuf::FieldDescriptor *> fields;
+  reflection->ListFields(packet, &fields);
+  for (const auto field : fields) {
+    if (field->cpp_type() !=
+        google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+      continue;
+    }
+    if (!field->is_repeated()) {
+      if (has_unknown_fields(reflection->GetMessage(packet, field))) {
+        return true;
+      }
+      continue;
+    }
+    const auto size = reflection->FieldSize(packet, field);
+    for (int i = 0; i < size; i++) {
+      if (has_unknown_fields(
+              reflection->GetRepeatedMessage(packet, field, i))) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+//! the packet itself or a copy of it in copy without the unknown fields
+const Packet &known_fields(const Packet &packet,
+                           std::unique_ptr<Packet> *copy) {
+  if (!has_unknown_fields(packet)) {
+    return packet;
+  }
+  copy->reset(packet.New());
+  (*copy)->CopyFrom(packet);
+  (*copy)->DiscardUnknownFields();
+  return **copy;
+}
+
+std::string to_deterministic_string(const Packet &packet) {
+  std::string output;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&output);
+    google::protobuf::io::CodedOutputStream stream(&string_stream);
+    // The map fields are sorted so that equal packets have the same bytes
+    stream.SetSerializationDeterministic(true);
+    packet.SerializePartialToCodedStream(&stream);
+  }
+  return output;
+}
+
+}  // namespace
+
+bool is_equal(const Packet &a, const Packet &b) {
+  if (&a == &b) {
+    return true;
+  }
+  std::unique_ptr<Packet> a_copy, b_copy;
+  const auto &a_known = known_fields(a, &a_copy);
+  const auto &b_known = known_fields(b, &b_copy);
+  if (a_known.ByteSizeLong() != b_known.ByteSizeLong()) {
+    return false;
+  }
+  return to_deterministic_string(a_known) == to_deterministic_string(b_known);
+}
+
+std::size_t hash_packet(const Packet &packet) {
+  std::unique_ptr<Packet> copy;
+  return std::hash<std::string>()(
+      to_deterministic_string(known_fields(packet, &copy)));
+}
+
 std::optional<Buffer> to_buffer(const Packet &packet) {
   Buffer buffer;
   if (!to_buffer(packet, &buffer)) {
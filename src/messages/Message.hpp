@@ -7,7 +7,9 @@
 #include <fstream>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -59,6 +61,12 @@ std::string to_json(const Packet &packet, bool pretty = false);
 bsoncxx::document::value to_bson(const Packet &packet);
 std::ostream &operator<<(std::ostream &os, const Packet &packet);
 
+//! compare and hash the deterministic serialization of the packets, the
+//! packets that have the same fields set to the same values are equal, the
+//! unknown fields are ignored as they were by the json comparison
+bool is_equal(const Packet &a, const Packet &b);
+std::size_t hash_packet(const Packet &packet);
+
 template <typename T>
 std::ostream &operator<<(
     std::ostream &os, const ::google::protobuf::RepeatedPtrField<T> &packets) {
@@ -79,12 +87,22 @@ int32_t fill_header_reply(const messages::Header &header_request,
 class Message : public _Message {
  public:
   using ID = decltype(((_Message *)nullptr)->header().id());
+  using BodyKeys = std::vector<uint64_t>;
+
+ private:
+  //! RecentBodies keys hashed from the received bytes of the bodies
+  BodyKeys _body_keys;
 
+ public:
   Message() { fill_header(mutable_header()); }
   Message(const std::string &json) { from_json(json, this); }
 
   Message(const Path &path) { from_json_file(path.string(), this); }
   virtual ~Message() {}
+
+  //! empty if the message was not received from a peer
+  const BodyKeys &body_keys() const { return _body_keys; }
+  void set_body_keys(BodyKeys body_keys) { _body_keys = std::move(body_keys); }
 };
 
 class Denunciation : public _Denunciation {
@@ -105,11 +123,16 @@ typename std::enable_if<
         std::is_base_of<::neuro::messages::Packet, TB>::value,
     bool>::type
 operator==(const TA &a, const TB &b) {
-  std::string json_a, json_b;
-  to_json(a, &json_a);
-  to_json(b, &json_b);
-  bool res = json_a == json_b;
-  return res;
+  if constexpr (std::is_base_of<Hash, TA>::value &&
+                std::is_base_of<Hash, TB>::value) {
+    return a.has_data() == b.has_data() && a.data() == b.data();
+  } else if constexpr (std::is_base_of<_KeyPub, TA>::value &&
+                       std::is_base_of<_KeyPub, TB>::value) {
+    return a.data_case() == b.data_case() && a.raw_data() == b.raw_data() &&
+           a.hex_data() == b.hex_data();
+  } else {
+    return is_equal(a, b);
+  }
 }
 
 template <typename TA, typename TB>
@@ -129,39 +152,44 @@ struct PacketHash {
   std::size_t operator()(typename std::enable_if<
                          std::is_base_of<::neuro::messages::Packet, T>::value,
                          T>::type const &s) const noexcept {
-    return std::hash<std::string>()(neuro::messages::to_json(s));
+    return neuro::messages::hash_packet(s);
   }
 };
 
+namespace std {
+
 template <>
-struct PacketHash<neuro::messages::_KeyPub> {
+struct hash<neuro::messages::_KeyPub> {
   std::size_t operator()(neuro::messages::_KeyPub const &s) const noexcept {
-    size_t key_as_bytes = *s.raw_data().data();
-    return key_as_bytes;
+    // All the bytes are hashed, the first one of a compressed key is only 2 or
+    // 3. The raw and hex forms compare different so their hashes can differ.
+    const auto &data = s.has_hex_data() ? s.hex_data() : s.raw_data();
+    return hash<string_view>()(data) ^ s.data_case();
   }
 };
 
-namespace std {
+}  // namespace std
 
 template <>
-struct hash<neuro::messages::_KeyPub> {
+struct PacketHash<neuro::messages::_KeyPub> {
   std::size_t operator()(neuro::messages::_KeyPub const &s) const noexcept {
-    size_t key_as_bytes = *s.raw_data().data();
-    return key_as_bytes;
+    return std::hash<neuro::messages::_KeyPub>()(s);
   }
 };
 
+namespace std {
+
 template <>
 struct hash<neuro::messages::Input> {
   size_t operator()(const neuro::messages::Input &input) const {
-    return hash<string>()(neuro::messages::to_json(input));
+    return neuro::messages::hash_packet(input);
   }
 };
 
 template <>
 struct hash<neuro::messages::Hash> {
   size_t operator()(const neuro::messages::Hash &hash_) const {
-    return hash<string>()(neuro::messages::to_json(hash_));
+    return hash<string_view>()(hash_.data());
   }
 };
 
@@ -169,14 +197,14 @@ template <>
 struct hash<neuro::messages::TaggedTransaction> {
   size_t operator()(
       const neuro::messages::TaggedTransaction &tagged_transaction) const {
-    return hash<string>()(neuro::messages::to_json(tagged_transaction));
+    return neuro::messages::hash_packet(tagged_transaction);
   }
 };
 
 template <>
 struct hash<neuro::messages::Address> {
   size_t operator()(const neuro::messages::Address &address) const {
-    return hash<string>()(::neuro::messages::to_json(address));
+    return neuro::messages::hash_packet(address);
   }
 };
 
@@ -138,6 +138,34 @@ std::vector<Peer> Peers::peers_copy() const {
   return res;
 }
 
+std::vector<Peer> Peers::connected_peers_copy() const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  std::vector<Peer> res;
+
+  for (const auto &[_, peer] : _peers) {
+    if (peer->status() & Peer::CONNECTED) {
+      res.push_back(*peer);
+    }
+  }
+
+  return res;
+}
+
+void Peers::set_status(Peer *peer, const Peer::Status status) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  peer->set_status(status);
+}
+
+Peer Peers::copy(const Peer &peer) const {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return peer;
+}
+
+void Peers::update(Peer *peer, const std::function<void(Peer *)> &update) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  update(peer);
+}
+
 void Peers::update_unreachable() {
   auto unreachables = by_status(Peer::UNREACHABLE);
   for (auto *peer : unreachables) {
@@ -104,6 +104,14 @@ class Peers {
   std::vector<Peer *> used_peers();
   std::vector<Peer *> connected_peers() const;
   std::vector<Peer> peers_copy() const;
+  //! copied under the lock, the handlers of other threads update the peers
+  std::vector<Peer> connected_peers_copy() const;
+  //! update the status under the lock so that the copies are consistent
+  void set_status(Peer *peer, const Peer::Status status);
+  //! copy of a single peer under the lock
+  Peer copy(const Peer &peer) const;
+  //! change a peer under the lock, for the fields other than its status
+  void update(Peer *peer, const std::function<void(Peer *)> &update);
   std::optional<Peer *> peer_by_port(const Port port) const;
   iterator begin();
   const iterator begin() const;
@@ -6,13 +6,47 @@
 namespace neuro {
 namespace messages {
 
+Queue::Lane Queue::lane(const Message &message) {
+  auto message_lane = TRANSACTIONS;
+  for (const auto &body : message.bodies()) {
+    switch (get_type(body)) {
+      case Type::kHello:
+      case Type::kWorld:
+      case Type::kConnectionClosed:
+      case Type::kConnectionReady:
+      case Type::kPing:
+      case Type::kHeartBeat:
+      case Type::kGetPeers:
+      case Type::kPeers:
+        return CONTROL;
+      case Type::kTransaction:
+      case Type::kInventory:
+      case Type::kGetInventory:
+        break;
+      default:
+        message_lane = BLOCKS;
+    }
+  }
+  return message_lane;
+}
+
 Queue::Queue() {
   add_filter_input(
       [](std::shared_ptr<const messages::Message> message) -> bool {
         const auto raw_ts = message->header().ts().data();
         return (std::abs(std::time(nullptr) - raw_ts) <= MESSAGE_TTL);
       });
+  set_lanes({"control", "blocks", "transactions"}, &Queue::lane);
+  set_source_of([](const Message &message) -> std::optional<Source> {
+    const auto &header = message.header();
+    if (!header.has_connection_id()) {
+      return {};
+    }
+    return header.connection_id();
+  });
 }
 
+RecentBodies &Queue::received_bodies() { return _received_bodies; }
+
 }  // namespace messages
 }  // namespace neuro
@@ -15,6 +15,7 @@
 #include "common/Queue.hpp"
 #include "common/logger.hpp"
 #include "messages/Message.hpp"
+#include "messages/RecentBodies.hpp"
 
 namespace neuro {
 namespace messages {
@@ -27,7 +28,21 @@ class Subscriber;
 
 class Queue : public ::neuro::Queue<Message, Subscriber> {
  public:
+  //! the control messages are not delayed by the blocks and the blocks are not
+  //! delayed by the transactions
+  enum Lane : std::size_t { CONTROL = 0, BLOCKS = 1, TRANSACTIONS = 2 };
+
+ private:
+  RecentBodies _received_bodies;
+
+ public:
+  static Lane lane(const Message &message);
+
   Queue();
+
+  //! bodies received from the connections, a message is dropped before its
+  //! signature is checked if they already sent all its bodies
+  RecentBodies &received_bodies();
   friend class neuro::messages::test::QueueTest;
 };
 
@@ -0,0 +1,152 @@
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "crypto/Hash.hpp"
+#include "messages/Message.hpp"
+#include "messages/RecentBodies.hpp"
+
+namespace neuro {
+namespace messages {
+
+namespace {
+
+//! periods covered by the buckets other than the current one
+constexpr std::time_t NB_PERIODS = RecentBodies::NB_BUCKETS - 1;
+
+std::size_t first_slot(RecentBodies::Key key, std::size_t mask) {
+  return ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+std::string random_hash_key() {
+  std::random_device random_device;
+  std::string hash_key(crypto::SIPHASH_KEY_SIZE, '\0');
+  for (auto &c : hash_key) {
+    c = static_cast<char>(random_device());
+  }
+  return hash_key;
+}
+
+const std::string &hash_key() {
+  static const std::string hash_key = random_hash_key();
+  return hash_key;
+}
+
+}  // namespace
+
+RecentBodies::RecentBodies(std::time_t ttl, std::size_t capacity)
+    : _period_duration(std::max<std::time_t>(
+          1, (ttl + NB_PERIODS - 1) / NB_PERIODS)),
+      _max_size(capacity - capacity / 4) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    throw std::runtime_error("RecentBodies capacity is not a power of 2");
+  }
+  for (auto &bucket : _buckets) {
+    bucket.slots.assign(capacity, 0);
+  }
+}
+
+RecentBodies::Key RecentBodies::key(std::string_view body_bytes) {
+  const auto body_key = crypto::hash_siphash(hash_key(), body_bytes);
+  // 0 marks the empty slots
+  return body_key == 0 ? 1 : body_key;
+}
+
+RecentBodies::Key RecentBodies::key(const Body &body) {
+  return key(body.SerializePartialAsString());
+}
+
+std::vector<RecentBodies::Key> RecentBodies::keys(const Buffer &buffer) {
+  using google::protobuf::internal::WireFormatLite;
+  constexpr auto BODIES_TAG =
+      WireFormatLite::MakeTag(_Message::kBodiesFieldNumber,
+                              WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  google::protobuf::io::CodedInputStream input(buffer.data(), buffer.size());
+  std::vector<Key> body_keys;
+  for (auto tag = input.ReadTag(); tag != 0; tag = input.ReadTag()) {
+    if (tag != BODIES_TAG) {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        return {};
+      }
+      continue;
+    }
+    uint32_t size;
+    if (!input.ReadVarint32(&size)) {
+      return {};
+    }
+    const auto begin = input.CurrentPosition();
+    if (!input.Skip(size)) {
+      return {};
+    }
+    body_keys.push_back(key(std::string_view(
+        reinterpret_cast<const char *>(buffer.data()) + begin, size)));
+  }
+  if (!input.ConsumedEntireMessage()) {
+    return {};
+  }
+  return body_keys;
+}
+
+RecentBodies::Key RecentBodies::key(const Message &message, int index) {
+  const auto &body_keys = message.body_keys();
+  if (body_keys.size() == static_cast<std::size_t>(message.bodies_size())) {
+    return body_keys[index];
+  }
+  return key(message.bodies(index));
+}
+
+bool RecentBodies::contains_in_period(Key key, std::time_t period) const {
+  for (const auto &bucket : _buckets) {
+    if (bucket.size == 0 ||
+        bucket.period + static_cast<std::time_t>(NB_BUCKETS) <= period) {
+      continue;
+    }
+    const auto mask = bucket.slots.size() - 1;
+    for (auto i = first_slot(key, mask); bucket.slots[i] != 0;
+         i = (i + 1) & mask) {
+      if (bucket.slots[i] == key) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool RecentBodies::insert_in_period(Key key, std::time_t period) {
+  if (contains_in_period(key, period)) {
+    return false;
+  }
+  auto &bucket = _buckets[period % NB_BUCKETS];
+  if (bucket.period < period) {
+    std::fill(bucket.slots.begin(), bucket.slots.end(), 0);
+    bucket.size = 0;
+    bucket.period = period;
+  }
+  // A bucket from a later period is kept as is if the clock went back
+  if (bucket.size >= _max_size) {
+    return true;
+  }
+  const auto mask = bucket.slots.size() - 1;
+  auto i = first_slot(key, mask);
+  while (bucket.slots[i] != 0) {
+    i = (i + 1) & mask;
+  }
+  bucket.slots[i] = key;
+  bucket.size++;
+  return true;
+}
+
+bool RecentBodies::contains(Key key, std::time_t current_time) const {
+  std::lock_guard lock(_mutex);
+  return contains_in_period(key, current_time / _period_duration);
+}
+
+bool RecentBodies::insert(Key key, std::time_t current_time) {
+  std::lock_guard lock(_mutex);
+  return insert_in_period(key, current_time / _period_duration);
+}
+
+}  // namespace messages
+}  // namespace neuro
@@ -0,0 +1,93 @@
+#ifndef NEURO_SRC_MESSAGES_RECENTBODIES_HPP
+#define NEURO_SRC_MESSAGES_RECENTBODIES_HPP
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "common/Buffer.hpp"
+#include "common/types.hpp"
+#include "messages.pb.h"
+
+namespace neuro {
+namespace messages {
+
+class Message;
+
+/**
+ * \brief Bodies seen during the last ttl seconds, in a fixed amount of memory
+ *
+ * The bodies are keyed by a hash of their bytes and not by the id they claim,
+ * which is not checked yet, so that a forged body does not hide the real one.
+ * The hash is keyed by a random secret of the process so that the peers cannot
+ * choose bodies that collide and so that all the tables share the keys of a
+ * received message, which are hashed once from its bytes. The keys are stored
+ * in NB_BUCKETS hash tables that each cover ttl / (NB_BUCKETS - 1) seconds,
+ * the oldest one is cleared and reused when the time moves to the next period.
+ * A key is kept at least ttl seconds. A full bucket does not remember new keys,
+ * they are seen as new again instead of using more memory.
+ */
+class RecentBodies {
+ public:
+  using Key = uint64_t;
+
+  static constexpr std::size_t NB_BUCKETS = 4;
+  static constexpr std::size_t DEFAULT_CAPACITY = 1 << 15;
+
+ private:
+  struct Bucket {
+    std::time_t period = 0;
+    std::size_t size = 0;
+    //! open addressing table, 0 is an empty slot
+    std::vector<Key> slots;
+  };
+
+  const std::time_t _period_duration;
+  const std::size_t _max_size;
+  mutable std::mutex _mutex;
+  std::array<Bucket, NB_BUCKETS> _buckets;
+
+  bool contains_in_period(Key key, std::time_t period) const;
+  bool insert_in_period(Key key, std::time_t period);
+
+ public:
+  /**
+   * \param ttl minimum number of seconds a body is remembered
+   * \param capacity number of slots of each bucket, a power of 2
+   */
+  explicit RecentBodies(std::time_t ttl = MESSAGE_TTL,
+                        std::size_t capacity = DEFAULT_CAPACITY);
+
+  //! hash of the bytes of a body
+  static Key key(std::string_view body_bytes);
+
+  //! hash of the serialized body, for the bodies that were not received
+  static Key key(const Body &body);
+
+  /**
+   * \brief Hash the bodies of a serialized message without parsing them
+   * \return one key per body in the order of the bodies, empty if the buffer
+   * is not a valid message
+   */
+  static std::vector<Key> keys(const Buffer &buffer);
+
+  //! key of a body of the message, from its received bytes when it has them
+  static Key key(const Message &message, int index);
+
+  //! true if the key was inserted during the last ttl seconds
+  bool contains(Key key, std::time_t current_time) const;
+
+  /**
+   * \brief Remember the key of a body
+   * \return false if the key was already there
+   */
+  bool insert(Key key, std::time_t current_time);
+};
+
+}  // namespace messages
+}  // namespace neuro
+
+#endif /* NEURO_SRC_MESSAGES_RECENTBODIES_HPP */
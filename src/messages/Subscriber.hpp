@@ -2,11 +2,12 @@
 #define NEURO_SRC_MESSAGES_SUBSCRIBER_HPP
 
 #include <set>
+#include <shared_mutex>
 #include <typeindex>
 #include <typeinfo>
-#include "crypto/Hash.hpp"
 #include "messages.pb.h"
 #include "messages/Queue.hpp"
+#include "messages/RecentBodies.hpp"
 
 namespace neuro {
 namespace messages {
@@ -17,12 +18,14 @@ class Subscriber {
   using CallbackR = std::function<void(const Message &message)>;
 
  private:
-  mutable std::mutex _mutex_handler;
+  //! the queue workers call handler() concurrently, they share this lock
+  //! while the callbacks are being changed
+  mutable std::shared_mutex _mutex_handler;
   ::neuro::messages::Queue *_queue;
   std::unordered_map<Message::ID, CallbackR> _callbacks_by_id;
   std::vector<std::vector<Callback>> _callbacks_by_type;
-  std::unordered_set<Buffer> _seen_messages_hash;
-  std::map<std::time_t, Buffer> _message_hash_by_ts;
+  //! the transactions and blocks already handled
+  RecentBodies _seen_bodies;
 
  public:
   Subscriber(messages::Queue *queue)
@@ -31,42 +34,23 @@ class Subscriber {
   }
 
   void subscribe(const Type type, const Callback &callback) {
+    std::unique_lock<std::shared_mutex> lock_handler(_mutex_handler);
     _callbacks_by_type[type].emplace_back(callback);
   }
 
   void subscribe(const Message::ID id, const CallbackR &callback) {
+    std::unique_lock<std::shared_mutex> lock_handler(_mutex_handler);
     _callbacks_by_id[id] = callback;
   }
 
   void unsubscribe() { _queue->unsubscribe(this); }
 
-  bool is_new_body(const std::time_t current_time, const messages::Body &body) {
-    // TODO move this to the queue
-    Buffer serialized_body;
-    to_buffer(body, &serialized_body);
-
-    const auto hash = crypto::hash_sha3_256(serialized_body);
-    const auto pair = _seen_messages_hash.emplace(hash);
-    if (!pair.second) {
-      return false;
-    }
-
-    _message_hash_by_ts.emplace(std::piecewise_construct,
-                                std::forward_as_tuple(current_time),
-                                std::forward_as_tuple(hash));
-
-    for (auto it = _message_hash_by_ts.begin(),
-              end = _message_hash_by_ts.lower_bound(current_time - MESSAGE_TTL);
-         it != end;) {
-      _seen_messages_hash.erase(it->second);
-      it = _message_hash_by_ts.erase(it);
-    }
-
-    return true;
+  bool is_new_body(const std::time_t current_time, RecentBodies::Key key) {
+    return _seen_bodies.insert(key, current_time);
   }
 
   void handler(std::shared_ptr<const Message> message) {
-    std::lock_guard<std::mutex> lock_handler(_mutex_handler);
+    std::shared_lock<std::shared_mutex> lock_handler(_mutex_handler);
 
     if (message->has_header() && message->header().has_id()) {
       const auto id = message->header().id();
@@ -77,12 +61,14 @@ class Subscriber {
     }
 
     const auto time = std::time(nullptr);
-    for (const auto &body : message->bodies()) {
+    for (int i = 0; i < message->bodies_size(); i++) {
+      const auto &body = message->bodies(i);
       const auto type = get_type(body);
       bool process{true};
       if (type == messages::Type::kTransaction ||
-          type == messages::Type::kBlock) {
-        process = is_new_body(time, body);
+          type == messages::Type::kBlock ||
+          type == messages::Type::kCompactBlock) {
+        process = is_new_body(time, RecentBodies::key(*message, i));
       }
 
       if (process) {
@@ -94,7 +80,7 @@ class Subscriber {
   }
 
   ~Subscriber() {
-    std::lock_guard<std::mutex> lock_handler(_mutex_handler);
+    // Waits for the workers of the queue that are calling handler()
     _queue->unsubscribe(this);
   }
 };
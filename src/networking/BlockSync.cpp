@@ -0,0 +1,286 @@
+#include <algorithm>
+
+#include "common/logger.hpp"
+#include "networking/BlockSync.hpp"
+
+namespace neuro {
+namespace networking {
+
+BlockSync::BlockSync(const Send &send, const AddBlock &add_block,
+                     const HasBlock &has_block)
+    : _send(send), _add_block(add_block), _has_block(has_block) {}
+
+bool BlockSync::start(const messages::BlockHeight tip_height,
+                      const messages::BlockID &tip_id,
+                      const std::vector<PeerID> &peers) {
+  std::lock_guard lock(_mutex);
+  if (_is_running || peers.empty()) {
+    return false;
+  }
+  _is_running = true;
+  _is_headers_done = false;
+  _peers = peers;
+  _last_header_id.CopyFrom(tip_id);
+  _last_header_height = tip_height;
+  _next_request_height = tip_height + 1;
+  _next_height = tip_height + 1;
+  _start_time = Timer::now();
+  _added_blocks = 0;
+  LOG_INFO << "Starting the sync from height " << tip_height << " with "
+           << peers.size() << " peers";
+
+  _pending.push_back({0, tip_height + 1, HEADERS_PER_REQUEST, true, 0, {}});
+  schedule();
+  return true;
+}
+
+bool BlockSync::handle_headers(const messages::Header &header,
+                               const messages::BlockHeaders &block_headers) {
+  std::lock_guard lock(_mutex);
+  if (!header.has_request_id()) {
+    return false;
+  }
+  const auto got = _requests.find(header.request_id());
+  if (got == _requests.end() || !got->second.headers_only) {
+    return false;
+  }
+  const auto request = got->second;
+  _requests.erase(got);
+
+  for (const auto &block_header : block_headers.headers()) {
+    if (block_header.height() != _last_header_height + 1 ||
+        block_header.previous_block_hash() != _last_header_id) {
+      LOG_WARNING << "Stopping the sync, the headers of peer " << request.peer
+                  << " do not follow height " << _last_header_height;
+      stop();
+      return true;
+    }
+    _headers[block_header.height()] = block_header.id();
+    _last_header_id.CopyFrom(block_header.id());
+    _last_header_height = block_header.height();
+  }
+
+  if (static_cast<uint32_t>(block_headers.headers_size()) == request.count) {
+    _pending.push_back({request.peer, _last_header_height + 1,
+                        HEADERS_PER_REQUEST, true, 0, {}});
+  } else {
+    _is_headers_done = true;
+  }
+  add_blocks();
+  schedule();
+  return true;
+}
+
+bool BlockSync::handle_block(const messages::Header &header,
+                             const messages::Block &block) {
+  std::lock_guard lock(_mutex);
+  if (!_is_running) {
+    return false;
+  }
+  const auto height = block.header().height();
+  const auto got = _headers.find(height);
+  if (got == _headers.end() || got->second != block.header().id()) {
+    return false;
+  }
+  const bool is_new = _blocks.emplace(height, block).second;
+
+  const auto request = _requests.find(header.request_id());
+  if (header.has_request_id() && request != _requests.end() &&
+      !request->second.headers_only) {
+    const auto first_height = request->second.height;
+    const auto last_height =
+        first_height +
+        static_cast<messages::BlockHeight>(request->second.count);
+    bool is_received = true;
+    for (auto i = first_height; i < last_height; i++) {
+      is_received &= i < _next_height || _blocks.count(i) > 0;
+    }
+    if (is_received) {
+      _requests.erase(request);
+    } else if (is_new && height >= first_height && height < last_height) {
+      request->second.is_answered = true;
+    }
+  }
+  add_blocks();
+  schedule();
+  return true;
+}
+
+void BlockSync::update(const std::vector<PeerID> &peers) {
+  std::lock_guard lock(_mutex);
+  _peers = peers;
+  if (!_is_running) {
+    return;
+  }
+
+  const auto now = Timer::now();
+  std::vector<Request> failed_requests;
+  for (auto it = _requests.begin(); it != _requests.end();) {
+    const auto &request = it->second;
+    const bool is_peer_gone =
+        std::find(_peers.begin(), _peers.end(), request.peer) == _peers.end();
+    if (is_peer_gone || request.deadline < now) {
+      failed_requests.push_back(request);
+      it = _requests.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (const auto &request : failed_requests) {
+    retry(request);
+    if (!_is_running) {
+      return;
+    }
+  }
+
+  LOG_INFO << "Sync at height " << _next_height - 1 << " / "
+           << _last_header_height << ", " << blocks_per_second()
+           << " blocks/s, " << _requests.size() << " requests in flight";
+  add_blocks();
+  schedule();
+}
+
+bool BlockSync::is_running() const {
+  std::lock_guard lock(_mutex);
+  return _is_running;
+}
+
+void BlockSync::retry(const Request &request) {
+  // A peer that sent some of the blocks did answer, it may have kept its reply
+  // under the maximum size of a message
+  const auto retries =
+      request.is_answered ? request.retries : request.retries + 1;
+  if (retries > MAX_RETRIES) {
+    LOG_WARNING << "Stopping the sync, no peer answered the request of "
+                << request.count << " blocks at height " << request.height;
+    stop();
+    return;
+  }
+  if (request.headers_only) {
+    _pending.push_front(request);
+    _pending.front().retries = retries;
+    return;
+  }
+
+  // Only ask the blocks of the window that are still missing, a block that
+  // was also gossiped may have been dropped as a duplicate so the ledger is
+  // checked before asking it again
+  auto first_height = request.height;
+  auto last_height =
+      request.height + static_cast<messages::BlockHeight>(request.count);
+  for (auto height = first_height; height < last_height; height++) {
+    if (height >= _next_height && _blocks.count(height) == 0 &&
+        _has_block(_headers.at(height))) {
+      _blocks.emplace(height, std::nullopt);
+    }
+  }
+  while (first_height < last_height &&
+         (first_height < _next_height || _blocks.count(first_height) > 0)) {
+    first_height++;
+  }
+  while (last_height > first_height && _blocks.count(last_height - 1) > 0) {
+    last_height--;
+  }
+  if (first_height == last_height) {
+    return;
+  }
+  _pending.push_front({request.peer, first_height,
+                       static_cast<uint32_t>(last_height - first_height),
+                       false, retries, {}});
+}
+
+bool BlockSync::send_request(Request request) {
+  // Round robin on the peers that are not busy, a request that failed is not
+  // sent again to the same peer unless it is the only one
+  for (std::size_t i = 0; i < _peers.size(); i++) {
+    const auto peer = _peers[(_next_peer + i) % _peers.size()];
+    if ((request.retries > 0 && peer == request.peer && _peers.size() > 1) ||
+        requests_count(peer) >= MAX_REQUESTS_PER_PEER) {
+      continue;
+    }
+
+    messages::Message message;
+    const auto request_id = messages::fill_header(message.mutable_header());
+    auto get_block = message.add_bodies()->mutable_get_block();
+    get_block->set_height(request.height);
+    get_block->set_count(request.count);
+    get_block->set_headers_only(request.headers_only);
+    if (!_send(message, peer)) {
+      continue;
+    }
+
+    _next_peer = (_next_peer + i + 1) % _peers.size();
+    request.peer = peer;
+    request.deadline = Timer::now() + REQUEST_TIMEOUT;
+    _requests[request_id] = request;
+    return true;
+  }
+  return false;
+}
+
+void BlockSync::schedule() {
+  while (!_pending.empty()) {
+    if (!send_request(_pending.front())) {
+      return;
+    }
+    _pending.pop_front();
+  }
+
+  while (_next_request_height <= _last_header_height &&
+         _next_request_height < _next_height + MAX_BLOCKS_AHEAD) {
+    const auto count = std::min<messages::BlockHeight>(
+        {static_cast<messages::BlockHeight>(BLOCKS_PER_REQUEST),
+         _last_header_height - _next_request_height + 1,
+         _next_height + MAX_BLOCKS_AHEAD - _next_request_height});
+    if (!send_request({0, _next_request_height, static_cast<uint32_t>(count),
+                       false, 0, {}})) {
+      return;
+    }
+    _next_request_height += count;
+  }
+}
+
+void BlockSync::add_blocks() {
+  for (auto it = _blocks.begin();
+       it != _blocks.end() && it->first == _next_height;
+       it = _blocks.erase(it)) {
+    // A block already known by the consensus is refused, that is not an error
+    if (it->second && !_add_block(*it->second)) {
+      LOG_DEBUG << "The consensus did not add the block at height "
+                << it->first;
+    }
+    _headers.erase(it->first);
+    _next_height++;
+    _added_blocks++;
+  }
+
+  if (_is_headers_done && _next_height > _last_header_height) {
+    LOG_INFO << "Sync done at height " << _last_header_height << ", "
+             << _added_blocks << " blocks at " << blocks_per_second()
+             << " blocks/s";
+    stop();
+  }
+}
+
+void BlockSync::stop() {
+  _is_running = false;
+  _requests.clear();
+  _pending.clear();
+  _headers.clear();
+  _blocks.clear();
+}
+
+std::size_t BlockSync::requests_count(PeerID peer) const {
+  return std::count_if(
+      _requests.begin(), _requests.end(),
+      [peer](const auto &request) { return request.second.peer == peer; });
+}
+
+double BlockSync::blocks_per_second() const {
+  const auto elapsed =
+      std::chrono::duration<double>(Timer::now() - _start_time).count();
+  return elapsed > 0 ? _added_blocks / elapsed : 0;
+}
+
+}  // namespace networking
+}  // namespace neuro
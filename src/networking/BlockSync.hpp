@@ -0,0 +1,140 @@
+#ifndef NEURO_SRC_NETWORKING_BLOCKSYNC_HPP
+#define NEURO_SRC_NETWORKING_BLOCKSYNC_HPP
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.hpp"
+#include "messages.pb.h"
+#include "messages/Message.hpp"
+#include "networking/Connection.hpp"
+
+namespace neuro {
+namespace networking {
+
+namespace test {
+class BlockSync;
+}  // namespace test
+
+/**
+ * \brief Headers first download of the blocks missing from the ledger
+ *
+ * The headers of the main branch of a peer are fetched from the height of our
+ * tip, they tell which blocks are missing. The bodies are then asked by
+ * windows of consecutive heights to all the connected peers at once, a window
+ * that is not received in time is asked again to another peer. A peer may
+ * send only the first blocks of a window, the rest is asked again and that
+ * does not count as a failure. The blocks are given to the consensus in the
+ * order of their height.
+ */
+class BlockSync {
+ public:
+  using PeerID = Connection::ID;
+  //! sends the message to a peer, returns false if it could not be sent
+  using Send = std::function<bool(const messages::Message &, PeerID)>;
+  using AddBlock = std::function<bool(const messages::Block &)>;
+  using HasBlock = std::function<bool(const messages::BlockID &)>;
+
+  static constexpr uint32_t HEADERS_PER_REQUEST = 256;
+  static constexpr uint32_t BLOCKS_PER_REQUEST = 8;
+  static constexpr std::size_t MAX_REQUESTS_PER_PEER = 2;
+  //! blocks downloaded ahead of the next one to add, it bounds the memory used
+  static constexpr messages::BlockHeight MAX_BLOCKS_AHEAD = 256;
+  static constexpr std::chrono::seconds REQUEST_TIMEOUT{10};
+  static constexpr uint32_t MAX_RETRIES = 3;
+  //! size of the blocks sent in one reply, the rest is left for the header
+  static constexpr std::size_t MAX_REPLY_SIZE = MAX_MESSAGE_SIZE - 4096;
+
+ private:
+  struct Request {
+    PeerID peer;
+    messages::BlockHeight height;
+    uint32_t count;
+    bool headers_only;
+    uint32_t retries;
+    Timer::time_point deadline;
+    //! some blocks were received, the rest is asked again without a retry
+    bool is_answered = false;
+  };
+
+  mutable std::mutex _mutex;
+  const Send _send;
+  const AddBlock _add_block;
+  const HasBlock _has_block;
+
+  bool _is_running = false;
+  bool _is_headers_done = false;
+  std::vector<PeerID> _peers;
+  std::size_t _next_peer = 0;
+  //! requests in flight by id
+  std::unordered_map<int32_t, Request> _requests;
+  //! requests waiting for a peer that is not busy
+  std::deque<Request> _pending;
+
+  //! last header received, the next one should be its child
+  messages::BlockID _last_header_id;
+  messages::BlockHeight _last_header_height = 0;
+  std::map<messages::BlockHeight, messages::BlockID> _headers;
+  //! lowest height that was never asked
+  messages::BlockHeight _next_request_height = 0;
+  //! blocks waiting for the previous ones, empty if already in the ledger
+  std::map<messages::BlockHeight, std::optional<messages::Block>> _blocks;
+  messages::BlockHeight _next_height = 0;
+
+  Timer::time_point _start_time;
+  std::size_t _added_blocks = 0;
+
+  bool send_request(Request request);
+  void retry(const Request &request);
+  void schedule();
+  void add_blocks();
+  void stop();
+  std::size_t requests_count(PeerID peer) const;
+  double blocks_per_second() const;
+
+ public:
+  BlockSync(const Send &send, const AddBlock &add_block,
+            const HasBlock &has_block);
+
+  /**
+   * \brief Start downloading the blocks after the given tip
+   * \return false if there is no peer or if a sync is already running
+   */
+  bool start(const messages::BlockHeight tip_height,
+             const messages::BlockID &tip_id, const std::vector<PeerID> &peers);
+
+  /**
+   * \brief Handle the reply to a headers request
+   * \return false if the reply was not asked by the sync
+   */
+  bool handle_headers(const messages::Header &header,
+                      const messages::BlockHeaders &block_headers);
+
+  /**
+   * \brief Handle a block, downloaded or not by the sync
+   * \return false if it is not a block of the sync
+   */
+  bool handle_block(const messages::Header &header,
+                    const messages::Block &block);
+
+  /**
+   * \brief Update the connected peers and ask again the requests that timed
+   * out or that were sent to a peer which is gone
+   */
+  void update(const std::vector<PeerID> &peers);
+
+  bool is_running() const;
+
+  friend class neuro::networking::test::BlockSync;
+};
+
+}  // namespace networking
+}  // namespace neuro
+
+#endif /* NEURO_SRC_NETWORKING_BLOCKSYNC_HPP */
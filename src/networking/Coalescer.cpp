@@ -0,0 +1,77 @@
+#include "networking/Coalescer.hpp"
+#include "common/logger.hpp"
+
+namespace neuro {
+namespace networking {
+
+Coalescer::Coalescer(const Send &send, std::size_t max_bytes,
+                     std::chrono::milliseconds max_delay)
+    : _send(send), _max_bytes(max_bytes), _max_delay(max_delay) {}
+
+void Coalescer::send(PeerID peer, messages::Message *message) {
+  messages::fill_header(message->mutable_header());
+  _messages++;
+  if (!_send(*message, peer)) {
+    LOG_DEBUG << "Could not send " << message->bodies_size()
+              << " bodies to peer " << peer;
+  }
+}
+
+void Coalescer::add(PeerID peer, const messages::Body &body) {
+  const auto body_size = body.ByteSizeLong();
+  _bodies++;
+  std::vector<messages::Message> ready_messages;
+  {
+    std::lock_guard lock(_mutex);
+    auto &batch = _batches[peer];
+    const bool is_empty = batch.message.bodies_size() == 0;
+    if (!is_empty && batch.size + body_size > _max_bytes) {
+      ready_messages.push_back(std::move(batch.message));
+      batch = Batch();
+    }
+    if (batch.message.bodies_size() == 0) {
+      batch.first_body_time = Timer::now();
+    }
+    batch.message.add_bodies()->CopyFrom(body);
+    batch.size += body_size;
+    if (batch.size >= _max_bytes) {
+      ready_messages.push_back(std::move(batch.message));
+      batch = Batch();
+    }
+  }
+  for (auto &message : ready_messages) {
+    send(peer, &message);
+  }
+}
+
+void Coalescer::flush(bool force) {
+  const auto now = Timer::now();
+  std::vector<std::pair<PeerID, messages::Message>> ready_messages;
+  {
+    std::lock_guard lock(_mutex);
+    for (auto it = _batches.begin(); it != _batches.end();) {
+      auto &batch = it->second;
+      const bool is_empty = batch.message.bodies_size() == 0;
+      if (is_empty || force || now - batch.first_body_time >= _max_delay) {
+        if (!is_empty) {
+          ready_messages.emplace_back(it->first, std::move(batch.message));
+        }
+        // The batches are removed once sent so that the ones of closed
+        // connections are not kept
+        it = _batches.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (auto &[peer, message] : ready_messages) {
+    send(peer, &message);
+  }
+}
+
+uint64_t Coalescer::bodies() const { return _bodies; }
+
+uint64_t Coalescer::messages() const { return _messages; }
+
+}  // namespace networking
+}  // namespace neuro
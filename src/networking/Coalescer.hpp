@@ -0,0 +1,78 @@
+#ifndef NEURO_SRC_NETWORKING_COALESCER_HPP
+#define NEURO_SRC_NETWORKING_COALESCER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.hpp"
+#include "messages.pb.h"
+#include "messages/Message.hpp"
+#include "networking/Connection.hpp"
+
+namespace neuro {
+namespace networking {
+
+/**
+ * \brief Pack the bodies sent to a peer in a single message
+ *
+ * Every message has its own header, frame signature and write, so the bodies
+ * sent to a peer are kept until they reach max_bytes or until the oldest one
+ * waited max_delay. flush() should be called at least every max_delay.
+ */
+class Coalescer {
+ public:
+  using PeerID = Connection::ID;
+  //! sends the message to a peer, returns false if it could not be sent
+  using Send = std::function<bool(const messages::Message &, PeerID)>;
+
+  static constexpr std::size_t DEFAULT_MAX_BYTES = 64 * 1024;
+  static constexpr std::chrono::milliseconds DEFAULT_MAX_DELAY{20};
+
+ private:
+  struct Batch {
+    messages::Message message;
+    std::size_t size = 0;
+    Timer::time_point first_body_time;
+  };
+
+  const Send _send;
+  const std::size_t _max_bytes;
+  const std::chrono::milliseconds _max_delay;
+  std::mutex _mutex;
+  std::unordered_map<PeerID, Batch> _batches;
+  std::atomic<uint64_t> _bodies{0};
+  std::atomic<uint64_t> _messages{0};
+
+  void send(PeerID peer, messages::Message *message);
+
+ public:
+  explicit Coalescer(const Send &send,
+                     std::size_t max_bytes = DEFAULT_MAX_BYTES,
+                     std::chrono::milliseconds max_delay = DEFAULT_MAX_DELAY);
+
+  /**
+   * \brief Queue a body for a peer, the batch of the peer is sent first if the
+   * body does not fit in it
+   */
+  void add(PeerID peer, const messages::Body &body);
+
+  /**
+   * \brief Send the batches whose oldest body waited max_delay
+   * \param force send all the batches
+   */
+  void flush(bool force = false);
+
+  //! number of bodies and of messages they were sent in
+  uint64_t bodies() const;
+  uint64_t messages() const;
+};
+
+}  // namespace networking
+}  // namespace neuro
+
+#endif /* NEURO_SRC_NETWORKING_COALESCER_HPP */
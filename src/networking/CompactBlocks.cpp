@@ -0,0 +1,170 @@
+#include "networking/CompactBlocks.hpp"
+#include "crypto/Hash.hpp"
+
+namespace neuro {
+namespace networking {
+
+CompactBlocks::CompactBlocks(std::size_t max_transactions)
+    : _max_transactions(max_transactions) {}
+
+CompactBlocks::ShortID CompactBlocks::short_id(
+    const messages::BlockID &block_id, const messages::TransactionID &id) {
+  return crypto::hash_siphash(block_id.data(), id.data());
+}
+
+bool CompactBlocks::check_block_id(const messages::Block &block) {
+  auto rehashed_block = block;
+  messages::set_block_hash(&rehashed_block);
+  return rehashed_block.header().id() == block.header().id();
+}
+
+bool CompactBlocks::compact(const messages::Block &block,
+                            messages::CompactBlock *compact_block) {
+  compact_block->Clear();
+  compact_block->mutable_header()->CopyFrom(block.header());
+  if (block.has_coinbase()) {
+    compact_block->mutable_coinbase()->CopyFrom(block.coinbase());
+  }
+  compact_block->mutable_denunciations()->CopyFrom(block.denunciations());
+
+  std::unordered_set<ShortID> short_ids;
+  for (const auto &transaction : block.transactions()) {
+    const auto id = short_id(block.header().id(), transaction.id());
+    if (!short_ids.insert(id).second) {
+      return false;
+    }
+    compact_block->add_short_transaction_ids(id);
+  }
+  return true;
+}
+
+bool CompactBlocks::get_transactions(
+    const messages::Block &block,
+    const messages::GetBlockTransactions &get_block_transactions,
+    messages::BlockTransactions *block_transactions) {
+  block_transactions->Clear();
+  block_transactions->mutable_block_id()->CopyFrom(block.header().id());
+  for (const auto index : get_block_transactions.indexes()) {
+    if (index >= static_cast<uint32_t>(block.transactions_size())) {
+      return false;
+    }
+    block_transactions->add_transactions()->CopyFrom(
+        block.transactions(index));
+  }
+  return true;
+}
+
+void CompactBlocks::add_transaction(const messages::Transaction &transaction) {
+  const auto &id = transaction.id().data();
+  std::lock_guard lock(_mutex);
+  if (!_transactions.emplace(id, transaction).second) {
+    return;
+  }
+  _transactions_order.push_back(id);
+  while (_transactions_order.size() > _max_transactions) {
+    _transactions.erase(_transactions_order.front());
+    _transactions_order.pop_front();
+  }
+}
+
+bool CompactBlocks::get_transaction(const messages::TransactionID &id,
+                                    messages::Transaction *transaction) const {
+  std::lock_guard lock(_mutex);
+  const auto got = _transactions.find(id.data());
+  if (got == _transactions.end()) {
+    return false;
+  }
+  transaction->CopyFrom(got->second);
+  return true;
+}
+
+bool CompactBlocks::rebuild(
+    const messages::CompactBlock &compact_block, messages::Block *block,
+    messages::GetBlockTransactions *get_block_transactions) {
+  block->Clear();
+  block->mutable_header()->CopyFrom(compact_block.header());
+  if (compact_block.has_coinbase()) {
+    block->mutable_coinbase()->CopyFrom(compact_block.coinbase());
+  }
+  block->mutable_denunciations()->CopyFrom(compact_block.denunciations());
+  get_block_transactions->Clear();
+  get_block_transactions->mutable_block_id()->CopyFrom(
+      compact_block.header().id());
+
+  const auto &block_id = compact_block.header().id();
+  std::lock_guard lock(_mutex);
+  // The short ids depend on the block so the transactions are indexed again
+  std::unordered_map<ShortID, const messages::Transaction *> transactions;
+  transactions.reserve(_transactions.size());
+  for (const auto &[id, transaction] : _transactions) {
+    const auto [got, is_inserted] = transactions.emplace(
+        short_id(block_id, transaction.id()), &transaction);
+    if (!is_inserted) {
+      // Several transactions have this short id, it is asked
+      got->second = nullptr;
+    }
+  }
+
+  PartialBlock partial_block;
+  for (int i = 0; i < compact_block.short_transaction_ids_size(); i++) {
+    const auto id = compact_block.short_transaction_ids(i);
+    auto transaction = block->add_transactions();
+    const auto got = transactions.find(id);
+    if (got != transactions.end() && got->second != nullptr) {
+      transaction->CopyFrom(*got->second);
+    } else {
+      get_block_transactions->add_indexes(i);
+      partial_block.missing_indexes.push_back(i);
+      partial_block.missing_short_ids.push_back(id);
+    }
+  }
+  if (partial_block.missing_indexes.empty()) {
+    return true;
+  }
+
+  const auto &key = block_id.data();
+  partial_block.block.CopyFrom(*block);
+  _partial_blocks[key] = std::move(partial_block);
+  _partial_blocks_order.push_back(key);
+  while (_partial_blocks_order.size() > MAX_PARTIAL_BLOCKS) {
+    _partial_blocks.erase(_partial_blocks_order.front());
+    _partial_blocks_order.pop_front();
+  }
+  return false;
+}
+
+bool CompactBlocks::complete(
+    const messages::BlockTransactions &block_transactions,
+    messages::Block *block) {
+  std::lock_guard lock(_mutex);
+  const auto got = _partial_blocks.find(block_transactions.block_id().data());
+  if (got == _partial_blocks.end()) {
+    return false;
+  }
+  auto &partial_block = got->second;
+  const auto &missing_indexes = partial_block.missing_indexes;
+  if (static_cast<std::size_t>(block_transactions.transactions_size()) !=
+      missing_indexes.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < missing_indexes.size(); i++) {
+    const auto &transaction = block_transactions.transactions(i);
+    if (short_id(block_transactions.block_id(), transaction.id()) !=
+        partial_block.missing_short_ids[i]) {
+      return false;
+    }
+    partial_block.block.mutable_transactions(missing_indexes[i])
+        ->CopyFrom(transaction);
+  }
+  block->Swap(&partial_block.block);
+  _partial_blocks.erase(got);
+  return true;
+}
+
+std::size_t CompactBlocks::transactions_count() const {
+  std::lock_guard lock(_mutex);
+  return _transactions.size();
+}
+
+}  // namespace networking
+}  // namespace neuro
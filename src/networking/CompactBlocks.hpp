@@ -0,0 +1,106 @@
+#ifndef NEURO_SRC_NETWORKING_COMPACTBLOCKS_HPP
+#define NEURO_SRC_NETWORKING_COMPACTBLOCKS_HPP
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "messages.pb.h"
+#include "messages/Message.hpp"
+
+namespace neuro {
+namespace networking {
+
+/**
+ * \brief Relay of the blocks without the transactions that were already
+ * gossiped
+ *
+ * The transactions received recently are kept so that a compact block can be
+ * rebuilt without them being sent again. The short ids are a hash keyed by the
+ * id of the block, so that transactions ground to collide for a block do not
+ * collide for the others. A block that misses some transactions is kept until
+ * the peer sends them. A rebuilt block has to be checked with check_block_id
+ * because 2 transactions can still have the same short id.
+ */
+class CompactBlocks {
+ public:
+  using ShortID = uint64_t;
+
+  static constexpr std::size_t MAX_TRANSACTIONS = 1 << 16;
+  static constexpr std::size_t MAX_PARTIAL_BLOCKS = 16;
+
+ private:
+  struct PartialBlock {
+    messages::Block block;
+    std::vector<uint32_t> missing_indexes;
+    std::vector<ShortID> missing_short_ids;
+  };
+
+  mutable std::mutex _mutex;
+  const std::size_t _max_transactions;
+  //! by the data of their id
+  std::unordered_map<std::string, messages::Transaction> _transactions;
+  std::deque<std::string> _transactions_order;  //!< oldest first
+  std::unordered_map<std::string, PartialBlock> _partial_blocks;
+  std::deque<std::string> _partial_blocks_order;  //!< oldest first
+
+ public:
+  explicit CompactBlocks(std::size_t max_transactions = MAX_TRANSACTIONS);
+
+  static ShortID short_id(const messages::BlockID &block_id,
+                          const messages::TransactionID &id);
+
+  //! true if the id of the block is the hash of its content
+  static bool check_block_id(const messages::Block &block);
+
+  /**
+   * \return false if 2 transactions of the block have the same short id, the
+   * whole block should be sent then
+   */
+  static bool compact(const messages::Block &block,
+                      messages::CompactBlock *compact_block);
+
+  /**
+   * \brief Copy the asked transactions of a block
+   * \return false if an index is not in the block
+   */
+  static bool get_transactions(
+      const messages::Block &block,
+      const messages::GetBlockTransactions &get_block_transactions,
+      messages::BlockTransactions *block_transactions);
+
+  //! remember a transaction that may be in a block later
+  void add_transaction(const messages::Transaction &transaction);
+
+  //! get a transaction that was remembered
+  bool get_transaction(const messages::TransactionID &id,
+                       messages::Transaction *transaction) const;
+
+  /**
+   * \brief Rebuild a block from the transactions that were received
+   * \return true if the block is complete, otherwise the missing transactions
+   * are set in get_block_transactions and the block is kept until they come.
+   * The transactions that have the same short id for this block are asked.
+   */
+  bool rebuild(const messages::CompactBlock &compact_block,
+               messages::Block *block,
+               messages::GetBlockTransactions *get_block_transactions);
+
+  /**
+   * \brief Complete a block with the transactions that were missing
+   * \return false if the block was not waiting for these transactions
+   */
+  bool complete(const messages::BlockTransactions &block_transactions,
+                messages::Block *block);
+
+  std::size_t transactions_count() const;
+};
+
+}  // namespace networking
+}  // namespace neuro
+
+#endif /* NEURO_SRC_NETWORKING_COMPACTBLOCKS_HPP */
@@ -0,0 +1,203 @@
+#include <algorithm>
+
+#include "networking/Inventory.hpp"
+
+namespace neuro {
+namespace networking {
+
+Inventory::KnownIDs::KnownIDs(std::size_t max_size) : _max_size(max_size) {}
+
+bool Inventory::KnownIDs::insert(const std::string &id) {
+  if (contains(id)) {
+    return false;
+  }
+  if (_current.size() >= _max_size / 2) {
+    _previous = std::move(_current);
+    _current.clear();
+  }
+  _current.insert(id);
+  return true;
+}
+
+bool Inventory::KnownIDs::contains(const std::string &id) const {
+  return _current.count(id) > 0 || _previous.count(id) > 0;
+}
+
+Inventory::KnownIDs *Inventory::known_ids(PeerID peer) {
+  const auto got = _known_ids_by_peer.find(peer);
+  return got == _known_ids_by_peer.end() ? nullptr : &got->second;
+}
+
+bool Inventory::is_new_transaction(const messages::TransactionID &id,
+                                   std::optional<PeerID> peer) {
+  const auto &key = id.data();
+  std::lock_guard lock(_mutex);
+  if (peer) {
+    if (auto peer_known_ids = known_ids(*peer)) {
+      peer_known_ids->insert(key);
+    }
+  }
+  if (_known_ids.contains(key)) {
+    _duplicates++;
+    return false;
+  }
+  return true;
+}
+
+bool Inventory::add_transaction(const messages::TransactionID &id,
+                                std::optional<PeerID> peer) {
+  const auto &key = id.data();
+  std::lock_guard lock(_mutex);
+  _requests.erase(key);
+  if (peer) {
+    if (auto peer_known_ids = known_ids(*peer)) {
+      peer_known_ids->insert(key);
+    }
+  }
+  if (!_known_ids.insert(key)) {
+    _duplicates++;
+    return false;
+  }
+  _received++;
+  return true;
+}
+
+void Inventory::announce_transaction(const messages::TransactionID &id,
+                                     const std::vector<PeerID> &peers) {
+  const auto &key = id.data();
+  std::lock_guard lock(_mutex);
+  for (const auto peer : peers) {
+    auto peer_known_ids = known_ids(peer);
+    if (peer_known_ids != nullptr && peer_known_ids->insert(key)) {
+      _announcements[peer].add_transaction_ids()->CopyFrom(id);
+      _announced++;
+    }
+  }
+}
+
+bool Inventory::handle_inventory(PeerID peer,
+                                 const messages::Inventory &inventory,
+                                 messages::GetInventory *get_inventory) {
+  get_inventory->Clear();
+  const auto now = Timer::now();
+  std::lock_guard lock(_mutex);
+  auto peer_known_ids = known_ids(peer);
+  if (peer_known_ids == nullptr) {
+    return false;
+  }
+  for (const auto &id : inventory.transaction_ids()) {
+    const auto &key = id.data();
+    peer_known_ids->insert(key);
+    if (_known_ids.contains(key)) {
+      _duplicates++;
+      continue;
+    }
+    const auto got = _requests.find(key);
+    if (got != _requests.end() && got->second.deadline > now) {
+      // Already asked to another peer, this one is asked if it times out
+      auto &announcers = got->second.announcers;
+      if (got->second.peer != peer && announcers.size() < MAX_ANNOUNCERS &&
+          std::find(announcers.begin(), announcers.end(), peer) ==
+              announcers.end()) {
+        announcers.push_back(peer);
+      }
+      continue;
+    }
+    if (static_cast<std::size_t>(get_inventory->transaction_ids_size()) >=
+        MAX_IDS_PER_MESSAGE) {
+      break;
+    }
+    _requests[key] = {peer, now + REQUEST_TIMEOUT, {}};
+    get_inventory->add_transaction_ids()->CopyFrom(id);
+    _requested++;
+  }
+  return get_inventory->transaction_ids_size() > 0;
+}
+
+std::vector<std::pair<Inventory::PeerID, messages::Inventory>>
+Inventory::flush() {
+  std::vector<std::pair<PeerID, messages::Inventory>> inventories;
+  std::lock_guard lock(_mutex);
+  for (auto &[peer, announcements] : _announcements) {
+    const auto &ids = announcements.transaction_ids();
+    const int max_ids = MAX_IDS_PER_MESSAGE;
+    for (int i = 0; i < ids.size(); i += max_ids) {
+      inventories.emplace_back(peer, messages::Inventory());
+      auto &inventory = inventories.back().second;
+      const int end = std::min(i + max_ids, ids.size());
+      for (int j = i; j < end; j++) {
+        inventory.add_transaction_ids()->CopyFrom(ids[j]);
+      }
+    }
+  }
+  _announcements.clear();
+  return inventories;
+}
+
+std::vector<std::pair<Inventory::PeerID, messages::GetInventory>>
+Inventory::retry_requests() {
+  std::unordered_map<PeerID, messages::GetInventory> get_inventories;
+  const auto now = Timer::now();
+  std::lock_guard lock(_mutex);
+  for (auto it = _requests.begin(); it != _requests.end();) {
+    auto &request = it->second;
+    if (request.deadline > now) {
+      ++it;
+      continue;
+    }
+    if (request.announcers.empty()) {
+      it = _requests.erase(it);
+      continue;
+    }
+    auto &get_inventory = get_inventories[request.announcers.front()];
+    if (static_cast<std::size_t>(get_inventory.transaction_ids_size()) <
+        MAX_IDS_PER_MESSAGE) {
+      // Otherwise it is asked at the next retry
+      request.peer = request.announcers.front();
+      request.announcers.pop_front();
+      request.deadline = now + REQUEST_TIMEOUT;
+      get_inventory.add_transaction_ids()->set_data(it->first);
+      _requested++;
+    }
+    ++it;
+  }
+
+  std::vector<std::pair<PeerID, messages::GetInventory>> requests;
+  for (auto &[peer, get_inventory] : get_inventories) {
+    requests.emplace_back(peer, std::move(get_inventory));
+  }
+  return requests;
+}
+
+void Inventory::add_peer(PeerID peer) {
+  std::lock_guard lock(_mutex);
+  // The ids of the connections are reused
+  _known_ids_by_peer[peer] = KnownIDs();
+}
+
+void Inventory::remove_peer(PeerID peer) {
+  const auto now = Timer::now();
+  std::lock_guard lock(_mutex);
+  _known_ids_by_peer.erase(peer);
+  _announcements.erase(peer);
+  for (auto &[id, request] : _requests) {
+    auto &announcers = request.announcers;
+    announcers.erase(std::remove(announcers.begin(), announcers.end(), peer),
+                     announcers.end());
+    if (request.peer == peer) {
+      // It will not answer, the next retry asks another peer
+      request.deadline = now;
+    }
+  }
+}
+
+uint64_t Inventory::announced() const { return _announced; }
+
+uint64_t Inventory::requested() const { return _requested; }
+
+uint64_t Inventory::received() const { return _received; }
+
+uint64_t Inventory::duplicates() const { return _duplicates; }
+
+}  // namespace networking
+}  // namespace neuro
@@ -0,0 +1,154 @@
+#ifndef NEURO_SRC_NETWORKING_INVENTORY_HPP
+#define NEURO_SRC_NETWORKING_INVENTORY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "common/types.hpp"
+#include "messages.pb.h"
+#include "messages/Message.hpp"
+#include "networking/Connection.hpp"
+
+namespace neuro {
+namespace networking {
+
+namespace test {
+class Inventory;
+}  // namespace test
+
+/**
+ * \brief Announce and request gossip of the transactions
+ *
+ * Instead of sending a new transaction to all the peers, its id is announced
+ * to the peers that are not known to have it. The announcements to a peer are
+ * batched until flush() is called. A peer asks the transactions it does not
+ * know, and a transaction being asked to a peer is not asked to another one
+ * until the request times out, it is then asked to the next peer that
+ * announced it. A transaction is known only once the consensus accepted it,
+ * so that a peer cannot hide a transaction by sending a forged one with the
+ * same id.
+ */
+class Inventory {
+ public:
+  using PeerID = Connection::ID;
+
+  //! ids remembered, by peer and for ourselves, before the oldest are dropped
+  static constexpr std::size_t MAX_KNOWN_IDS = 1 << 16;
+  static constexpr std::size_t MAX_IDS_PER_MESSAGE = 1024;
+  static constexpr std::chrono::seconds REQUEST_TIMEOUT{5};
+  //! peers remembered to ask a transaction again if a request times out
+  static constexpr std::size_t MAX_ANNOUNCERS = 8;
+
+ private:
+  /**
+   * \brief Set of ids that forgets the oldest ones, they are kept in 2
+   * generations and the oldest one is dropped when the newest is full
+   */
+  class KnownIDs {
+   private:
+    std::size_t _max_size;
+    std::unordered_set<std::string> _current;
+    std::unordered_set<std::string> _previous;
+
+   public:
+    explicit KnownIDs(std::size_t max_size = MAX_KNOWN_IDS);
+    //! returns false if the id was already known
+    bool insert(const std::string &id);
+    bool contains(const std::string &id) const;
+  };
+
+  struct Request {
+    PeerID peer;
+    Timer::time_point deadline;
+    //! the other peers that announced the transaction, first come first
+    std::deque<PeerID> announcers;
+  };
+
+  mutable std::mutex _mutex;
+  KnownIDs _known_ids;
+  std::unordered_map<PeerID, KnownIDs> _known_ids_by_peer;
+  std::unordered_map<PeerID, messages::Inventory> _announcements;
+  std::unordered_map<std::string, Request> _requests;
+
+  std::atomic<uint64_t> _announced{0};
+  std::atomic<uint64_t> _requested{0};
+  std::atomic<uint64_t> _received{0};
+  std::atomic<uint64_t> _duplicates{0};
+
+  //! nullptr for the peers that were not added or that were removed
+  KnownIDs *known_ids(PeerID peer);
+
+ public:
+  /**
+   * \brief Check a received transaction before it is validated
+   * \param peer the peer that sent it if any, it will not be announced to it
+   * \return false if the transaction was already accepted
+   */
+  bool is_new_transaction(const messages::TransactionID &id,
+                          std::optional<PeerID> peer);
+
+  /**
+   * \brief Remember a transaction that the consensus accepted
+   * \param peer the peer that sent it if any, it will not be announced to it
+   * \return false if the transaction was already known
+   */
+  bool add_transaction(const messages::TransactionID &id,
+                       std::optional<PeerID> peer);
+
+  //! queue the announcement to the peers that do not know the transaction
+  void announce_transaction(const messages::TransactionID &id,
+                            const std::vector<PeerID> &peers);
+
+  /**
+   * \brief Handle the announcements of a peer
+   * \return false if there is nothing to ask, otherwise get_inventory holds
+   * the transactions to ask
+   */
+  bool handle_inventory(PeerID peer, const messages::Inventory &inventory,
+                        messages::GetInventory *get_inventory);
+
+  /**
+   * \brief Take the announcements queued for each peer, split in messages of
+   * MAX_IDS_PER_MESSAGE ids at most
+   */
+  std::vector<std::pair<PeerID, messages::Inventory>> flush();
+
+  /**
+   * \brief Ask again the transactions whose request timed out, to the next
+   * peer that announced them. The ones that no other peer announced are
+   * forgotten, they will be asked to the next peer that announces them.
+   */
+  std::vector<std::pair<PeerID, messages::GetInventory>> retry_requests();
+
+  /**
+   * \brief Start tracking a connected peer, the messages of the other peers
+   * are ignored so that a removed peer is not tracked again by a message
+   * handled after its disconnection
+   */
+  void add_peer(PeerID peer);
+  void remove_peer(PeerID peer);
+
+  //! ids announced to peers, counted once per peer
+  uint64_t announced() const;
+  //! ids asked to peers
+  uint64_t requested() const;
+  //! transactions received for the first time
+  uint64_t received() const;
+  //! transactions and announcements received for known transactions
+  uint64_t duplicates() const;
+
+  friend class neuro::networking::test::Inventory;
+};
+
+}  // namespace networking
+}  // namespace neuro
+
+#endif /* NEURO_SRC_NETWORKING_INVENTORY_HPP */
@@ -17,6 +17,7 @@ Networking::Networking(messages::Queue *queue, crypto::Ecc *keys,
     : _queue(queue),
       _keys(keys),
       _dist(0, std::numeric_limits<uint32_t>::max()) {
+  _queue->set_workers(config->queue_workers());
   _queue->run();
   _transport_layer = std::make_unique<Tcp>(queue, peers, _keys, *config);
 }
@@ -0,0 +1,60 @@
+#include <stdexcept>
+
+#include "common/logger.hpp"
+#include "networking/tcp/Compression.hpp"
+
+namespace neuro {
+namespace networking {
+namespace tcp {
+
+Compressor::Compressor() : _context(ZSTD_createCCtx()) {
+  if (_context == nullptr) {
+    throw std::runtime_error("Could not create compression context");
+  }
+}
+
+Compressor::~Compressor() { ZSTD_freeCCtx(_context); }
+
+bool Compressor::compress(const Buffer &data, Buffer *output, int level) {
+  if (data.size() < MIN_SIZE) {
+    return false;
+  }
+  output->resize(ZSTD_compressBound(data.size()));
+  const auto size = ZSTD_compressCCtx(_context, output->data(), output->size(),
+                                      data.data(), data.size(), level);
+  if (ZSTD_isError(size)) {
+    LOG_WARNING << "Could not compress frame " << ZSTD_getErrorName(size);
+    return false;
+  }
+  if (size >= data.size()) {
+    return false;
+  }
+  output->resize(size);
+  return true;
+}
+
+Decompressor::Decompressor() : _context(ZSTD_createDCtx()) {
+  if (_context == nullptr) {
+    throw std::runtime_error("Could not create decompression context");
+  }
+}
+
+Decompressor::~Decompressor() { ZSTD_freeDCtx(_context); }
+
+bool Decompressor::decompress(const Buffer &data, std::size_t max_size,
+                              Buffer *output) {
+  const auto content_size = ZSTD_getFrameContentSize(data.data(), data.size());
+  if (content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+      content_size == ZSTD_CONTENTSIZE_ERROR || content_size > max_size) {
+    return false;
+  }
+  output->resize(content_size);
+  const auto size = ZSTD_decompressDCtx(_context, output->data(),
+                                        output->size(), data.data(),
+                                        data.size());
+  return !ZSTD_isError(size) && size == content_size;
+}
+
+}  // namespace tcp
+}  // namespace networking
+}  // namespace neuro
@@ -0,0 +1,63 @@
+#ifndef NEURO_SRC_NETWORKING_TCP_COMPRESSION_HPP
+#define NEURO_SRC_NETWORKING_TCP_COMPRESSION_HPP
+
+#include <zstd.h>
+
+#include "common/Buffer.hpp"
+
+namespace neuro {
+namespace networking {
+namespace tcp {
+
+/**
+ * \brief zstd compression context, reused for all the frames it compresses
+ */
+class Compressor {
+ public:
+  //! bodies smaller than this are not worth compressing
+  static constexpr std::size_t MIN_SIZE = 1024;
+  static constexpr int DEFAULT_LEVEL = 3;
+
+ private:
+  ZSTD_CCtx *_context;
+
+ public:
+  Compressor();
+  Compressor(const Compressor &) = delete;
+  Compressor &operator=(const Compressor &) = delete;
+  ~Compressor();
+
+  /**
+   * \brief Compress data in output
+   * \return false if the data is too small or does not get smaller
+   */
+  bool compress(const Buffer &data, Buffer *output,
+                int level = DEFAULT_LEVEL);
+};
+
+/**
+ * \brief zstd decompression context, reused for all the frames it decompresses
+ */
+class Decompressor {
+ private:
+  ZSTD_DCtx *_context;
+
+ public:
+  Decompressor();
+  Decompressor(const Decompressor &) = delete;
+  Decompressor &operator=(const Decompressor &) = delete;
+  ~Decompressor();
+
+  /**
+   * \brief Decompress data in output
+   * \param max_size frames announcing a bigger content are refused
+   * \return false if the data is not a valid frame
+   */
+  bool decompress(const Buffer &data, std::size_t max_size, Buffer *output);
+};
+
+}  // namespace tcp
+}  // namespace networking
+}  // namespace neuro
+
+#endif /* NEURO_SRC_NETWORKING_TCP_COMPRESSION_HPP */
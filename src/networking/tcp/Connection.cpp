@@ -1,7 +1,9 @@
 #include <cassert>
 
+#include "common/BufferPool.hpp"
 #include "common/logger.hpp"
 #include "config.pb.h"
+#include "crypto/KeyPubCache.hpp"
 #include "messages/Peer.hpp"
 #include "messages/Queue.hpp"
 #include "networking/Connection.hpp"
@@ -11,16 +13,34 @@ namespace neuro {
 namespace networking {
 namespace tcp {
 
+namespace {
+
+//! the bodies that are relayed by all the peers
+bool is_deduplicated(messages::Type type) {
+  return type == messages::Type::kTransaction ||
+         type == messages::Type::kBlock ||
+         type == messages::Type::kCompactBlock;
+}
+
+}  // namespace
+
 Connection::Connection(const ID id, messages::Queue *queue,
+                       messages::Peers *peers,
                        const std::shared_ptr<tcp::socket> &socket,
-                       std::shared_ptr<messages::Peer> remote_peer)
+                       std::shared_ptr<messages::Peer> remote_peer,
+                       boost::asio::thread_pool *verifier)
     : ::neuro::networking::Connection::Connection(id, queue),
       _header(sizeof(HeaderPattern), 0),
-      _buffer(128, 0),
+      _buffer(BufferPool::instance().acquire(128)),
+      _compressed_buffer(BufferPool::instance().acquire(128)),
       _socket(socket),
+      _strand(socket->get_executor()),
+      _verifier(verifier),
+      _peers(peers),
       _remote_peer(remote_peer) {
   assert(_socket != nullptr);
-  remote_peer->set_connection_id(id);
+  _peers->update(remote_peer.get(),
+                 [id](messages::Peer *peer) { peer->set_connection_id(id); });
 }
 
 std::shared_ptr<const tcp::socket> Connection::socket() const {
@@ -41,8 +61,10 @@ const std::string Connection::ip() const {
 void Connection::read_header() {
   boost::asio::async_read(
       *_socket, boost::asio::buffer(_header.data(), _header.size()),
-      [_this = ptr()](const boost::system::error_code &error,
-                      std::size_t bytes_read) {
+      boost::asio::bind_executor(_strand, [_this = ptr()](
+                                              const boost::system::error_code
+                                                  &error,
+                                              std::size_t bytes_read) {
         if (error) {
           LOG_WARNING << " read header error " << error.message() << " "
                       << _this->ip() << ":" << *_this->remote_port() << ":"
@@ -56,28 +78,54 @@ void Connection::read_header() {
           LOG_WARNING << "Receiving message too big " << header_pattern->size;
           return;
         }
-        _this->read_body(header_pattern->size);
-      });
+        const auto compression = header_pattern->compression;
+        if (compression != Compression::NONE &&
+            compression != Compression::ZSTD) {
+          LOG_INFO << "Killing connection because of unknown compression "
+                   << static_cast<uint32_t>(compression) << " "
+                   << _this->ip();
+          _this->terminate();
+          return;
+        }
+        _this->read_body(header_pattern->size, compression);
+      }));
 }
 
-void Connection::read_body(std::size_t body_size) {
-  _buffer.resize(body_size);
+void Connection::read_body(std::size_t body_size, Compression compression) {
+  const bool is_compressed = compression == Compression::ZSTD;
+  auto &buffer = is_compressed ? _compressed_buffer : _buffer;
+  // Buffer does not zero fill on resize so growing it is cheap
+  buffer->resize(body_size);
   boost::asio::async_read(
-      *_socket, boost::asio::buffer(_buffer.data(), _buffer.size()),
-      [_this = ptr(), this](const boost::system::error_code &error,
-                            std::size_t bytes_read) {
+      *_socket, boost::asio::buffer(buffer->data(), buffer->size()),
+      boost::asio::bind_executor(_strand, [_this = ptr(), this, is_compressed](
+                                              const boost::system::error_code
+                                                  &error,
+                                              std::size_t bytes_read) {
         if (error) {
           LOG_WARNING << this << " read body error " << error.message() << " "
                       << ip();
           _this->terminate();
           return;
         }
+        if (is_compressed &&
+            !_decompressor.decompress(*_compressed_buffer, MAX_MESSAGE_SIZE,
+                                      _buffer.get())) {
+          LOG_INFO << "Killing connection because of invalid compressed frame "
+                   << ip() << ":" << remote_port().value_or(0) << ":" << _id;
+          _this->terminate();
+          return;
+        }
 
         const auto header_pattern =
             reinterpret_cast<HeaderPattern *>(_this->_header.data());
 
         auto message = std::make_shared<messages::Message>();
-        messages::from_buffer(_this->_buffer, message.get());
+        // The bodies are hashed once here and their keys are reused to
+        // drop and remember the bodies already received
+        message->set_body_keys(
+            messages::RecentBodies::keys(*_this->_buffer));
+        messages::from_buffer(*_this->_buffer, message.get());
         auto header = message->mutable_header();
 
         header->set_connection_id(_id);
@@ -109,82 +157,237 @@ void Connection::read_body(std::size_t body_size) {
               auto *hello = body.mutable_hello();
               hello->mutable_peer()->set_endpoint(
                   endpoint.address().to_string());
-              _remote_peer->CopyFrom(hello->peer());
-              _remote_peer->set_connection_id(_id);
+              _peers->update(_remote_peer.get(),
+                             [this, hello](messages::Peer *peer) {
+                               peer->CopyFrom(hello->peer());
+                               peer->set_connection_id(_id);
+                             });
+              _remote_key_pub.reset();
+              set_remote_compression(hello->compressions());
             }
+          } else if (type == messages::Type::kWorld) {
+            set_remote_compression(body.world().compressions());
           }
         }
 
-        if (!_this->_remote_peer->has_key_pub()) {
+        if (!_this->_peers->copy(*_this->_remote_peer).has_key_pub()) {
           LOG_INFO
               << "Killing connection because received message without key pub "
               << ip() << ":" << remote_port().value_or(0) << ":" << _id;
           _this->terminate();
           return;
         }
-        const auto key_pub = _this->_remote_peer->key_pub();
+        if (is_received(*message)) {
+          LOG_DEBUG << this << " drops a message already received from "
+                    << ip();
+          _this->read_header();
+          return;
+        }
+        _this->verify(message);
+      }));
+}
+
+bool Connection::is_received(const messages::Message &message) const {
+  // The replies are handled even if their bodies were relayed already
+  if (message.header().has_request_id() || message.bodies_size() == 0) {
+    return false;
+  }
+  const auto current_time = std::time(nullptr);
+  const auto &received_bodies = _queue->received_bodies();
+  for (int i = 0; i < message.bodies_size(); i++) {
+    if (!is_deduplicated(get_type(message.bodies(i))) ||
+        !received_bodies.contains(messages::RecentBodies::key(message, i),
+                                  current_time)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-        crypto::KeyPub ecc_pub(key_pub);
+template <typename Compressions>
+void Connection::set_remote_compression(const Compressions &compressions) {
+  auto compression = Compression::NONE;
+  for (const auto codec : compressions) {
+    if (codec == messages::Compression::ZSTD) {
+      compression = Compression::ZSTD;
+    }
+  }
+  _remote_compression = compression;
+}
 
-        const auto check =
-            ecc_pub.verify(_this->_buffer, header_pattern->signature,
+void Connection::verify(std::shared_ptr<messages::Message> message) {
+  if (!_remote_key_pub) {
+    try {
+      // The key of the peer checks all its messages
+      _remote_key_pub = crypto::KeyPubCache::instance().get(
+          _peers->copy(*_remote_peer).key_pub(), true);
+    } catch (const std::runtime_error &e) {
+      LOG_INFO << "Killing connection because of invalid key pub " << ip()
+               << ":" << remote_port().value_or(0) << ":" << _id << " "
+               << e.what();
+      terminate();
+      return;
+    }
+  }
+  // The next message is only read once this one is dispatched so _buffer and
+  // _header are not modified during the verification
+  const auto check = [_this = ptr(), key_pub = _remote_key_pub]() {
+    const auto header_pattern =
+        reinterpret_cast<const HeaderPattern *>(_this->_header.data());
+    return key_pub->verify(*_this->_buffer, header_pattern->signature,
                            sizeof(header_pattern->signature));
+  };
+  if (_verifier == nullptr) {
+    dispatch(message, check());
+    return;
+  }
+  boost::asio::post(*_verifier, [_this = ptr(), message, check]() {
+    const bool is_valid = check();
+    boost::asio::post(_this->_strand, [_this, message, is_valid]() {
+      _this->dispatch(message, is_valid);
+    });
+  });
+}
 
-        if (!check) {
-          LOG_INFO << "Bad signature on incomming message";
-          _this->terminate();
-          return;
-        }
-        try {
-          LOG_DEBUG << "Receiving [" << _socket->remote_endpoint() << ":"
-                    << _remote_peer->port() << "]: " << *message;
-        } catch (...) {
-          _this->_buffer.save("conf/crashed.proto");
-          _this->terminate();
-          return;
-        }
-        message->mutable_header()->mutable_key_pub()->CopyFrom(
-            _remote_peer->key_pub());
+void Connection::dispatch(std::shared_ptr<messages::Message> message,
+                          bool check) {
+  if (!check) {
+    LOG_INFO << "Bad signature on incomming message";
+    terminate();
+    return;
+  }
+  const auto remote_peer = _peers->copy(*_remote_peer);
+  try {
+    LOG_DEBUG << "Receiving [" << _socket->remote_endpoint() << ":"
+              << remote_peer.port() << "]: " << *message;
+  } catch (...) {
+    _buffer->save("conf/crashed.proto");
+    terminate();
+    return;
+  }
+  message->mutable_header()->mutable_key_pub()->CopyFrom(
+      remote_peer.key_pub());
 
-        bool is_hello = false;
-        bool is_world = false;
-        if (message->bodies_size() > 0) {
-          const auto type = get_type(message->bodies(0));
-          if (type == messages::Type::kHello) {
-            is_hello = message->bodies_size() == 1;
-          } else if (type == messages::Type::kWorld) {
-            is_world = true;
-          }
-        }
-        if (_remote_peer->status() == messages::Peer::CONNECTED || is_hello ||
-            (_remote_peer->status() == messages::Peer::CONNECTING &&
-             is_world)) {
-          _this->_queue->push(message);
-        } else {
-          LOG_WARNING << "Message from " << _remote_peer
-                      << " was not sent to the queue because the sender "
-                         "is not a connected peer "
-                      << *message;
-          _this->terminate();
-          return;
-        }
-        _this->read_header();
-      });
+  bool is_hello = false;
+  bool is_world = false;
+  if (message->bodies_size() > 0) {
+    const auto type = get_type(message->bodies(0));
+    if (type == messages::Type::kHello) {
+      is_hello = message->bodies_size() == 1;
+    } else if (type == messages::Type::kWorld) {
+      is_world = true;
+    }
+  }
+  if (remote_peer.status() == messages::Peer::CONNECTED || is_hello ||
+      (remote_peer.status() == messages::Peer::CONNECTING && is_world)) {
+    const auto current_time = std::time(nullptr);
+    auto &received_bodies = _queue->received_bodies();
+    for (int i = 0; i < message->bodies_size(); i++) {
+      if (is_deduplicated(get_type(message->bodies(i)))) {
+        received_bodies.insert(messages::RecentBodies::key(*message, i),
+                               current_time);
+      }
+    }
+    _queue->push(message);
+    // The socket is not read while the peer is over its share of the queue,
+    // so that a flooding peer is slowed down by tcp instead of using memory
+    const bool is_paused = _queue->pause(_id, [_this = ptr()]() {
+      boost::asio::post(_this->_strand, [_this]() { _this->read_header(); });
+    });
+    if (is_paused) {
+      LOG_DEBUG << "Pause reading from " << _id << " until the queue drains";
+      return;
+    }
+  } else {
+    LOG_WARNING << "Message from " << remote_peer
+                << " was not sent to the queue because the sender "
+                   "is not a connected peer "
+                << *message;
+    terminate();
+    return;
+  }
+  read_header();
+}
+
+bool Connection::send(const std::shared_ptr<const Buffer> &header,
+                      const std::shared_ptr<const Buffer> &body) {
+  std::lock_guard lock(_write_mutex);
+  const auto size = header->size() + body->size();
+  if (_queued_messages >= MAX_QUEUED_MESSAGES ||
+      _queued_bytes + size > MAX_QUEUED_BYTES) {
+    LOG_WARNING << "not sending message because the write queue of "
+                << _id << " is full (" << _queued_messages << " messages, "
+                << _queued_bytes << " bytes)";
+    return false;
+  }
+  _write_queue.push_back({header, body});
+  _queued_messages++;
+  _queued_bytes += size;
+  if (!_is_writing) {
+    _is_writing = true;
+    // The socket is only used from the strand of the connection
+    boost::asio::post(_strand, [_this = ptr()]() { _this->write(); });
+  }
+  return true;
 }
 
-bool Connection::send(std::shared_ptr<Buffer> &message) {
+void Connection::write() {
+  std::vector<boost::asio::const_buffer> buffers;
+  {
+    std::lock_guard lock(_write_mutex);
+    _messages_in_flight.clear();
+    while (!_write_queue.empty() &&
+           _messages_in_flight.size() < MAX_MESSAGES_PER_WRITE) {
+      auto &message = _messages_in_flight.emplace_back(
+          std::move(_write_queue.front()));
+      _write_queue.pop_front();
+      buffers.emplace_back(message.header->data(), message.header->size());
+      buffers.emplace_back(message.body->data(), message.body->size());
+    }
+    if (_messages_in_flight.empty()) {
+      _is_writing = false;
+      return;
+    }
+  }
+
   boost::asio::async_write(
-      *_socket, boost::asio::buffer(message->data(), message->size()),
-      [_this = ptr(), message](const boost::system::error_code &error,
-                               std::size_t bytes_transferred) {
+      *_socket, buffers,
+      boost::asio::bind_executor(_strand, [_this = ptr()](
+                                              const boost::system::error_code
+                                                  &error,
+                                              std::size_t bytes_transferred) {
         if (error) {
           LOG_WARNING << "send error " << error.message();
+          _this->clear_write_queue();
           _this->terminate();
-          return false;
+          return;
         }
-        return true;
-      });
-  return true;
+        {
+          std::lock_guard lock(_this->_write_mutex);
+          _this->_queued_messages -= _this->_messages_in_flight.size();
+          _this->_queued_bytes -= bytes_transferred;
+        }
+        _this->write();
+      }));
+}
+
+void Connection::clear_write_queue() {
+  std::lock_guard lock(_write_mutex);
+  _write_queue.clear();
+  _messages_in_flight.clear();
+  _queued_messages = 0;
+  _queued_bytes = 0;
+  _is_writing = false;
+}
+
+std::size_t Connection::queued_messages() const {
+  std::lock_guard lock(_write_mutex);
+  return _queued_messages;
+}
+
+std::size_t Connection::queued_bytes() const {
+  std::lock_guard lock(_write_mutex);
+  return _queued_bytes;
 }
 
 void Connection::close() { _socket->close(); }
@@ -208,8 +411,10 @@ void Connection::terminate(bool from_inside) const {
   header->set_connection_id(_id);
   auto body = message->add_bodies();
   body->mutable_connection_closed();
-  _remote_peer->set_status(messages::Peer::UNREACHABLE);
-  _remote_peer->clear_connection_id();
+  _peers->update(_remote_peer.get(), [](messages::Peer *peer) {
+    peer->set_status(messages::Peer::UNREACHABLE);
+    peer->clear_connection_id();
+  });
   _queue->push(message);
 }
 
@@ -244,6 +449,10 @@ std::shared_ptr<messages::Peer> Connection::remote_peer() const {
   return _remote_peer;
 }
 
+Compression Connection::remote_compression() const {
+  return _remote_compression;
+}
+
 std::shared_ptr<Connection> Connection::ptr() { return shared_from_this(); }
 
 Connection::~Connection() {
@@ -2,55 +2,123 @@
 #define NEURO_SRC_NETWORKING_TCP_CONNECTION_HPP
 
 #include <boost/asio.hpp>
+#include <atomic>
 #include <cmath>
 #include <cstdio>
+#include <deque>
 #include <iostream>
+#include <mutex>
 
 #include "common/Buffer.hpp"
 #include "config.pb.h"
+#include "crypto/KeyPub.hpp"
 #include "messages.pb.h"
 #include "messages/Peer.hpp"
+#include "messages/Peers.hpp"
 #include "messages/Queue.hpp"
 #include "networking/Connection.hpp"
 #include "networking/TransportLayer.hpp"
+#include "networking/tcp/Compression.hpp"
 #include "networking/tcp/HeaderPattern.hpp"
 
 namespace neuro {
 namespace networking {
+namespace test {
+class Tcp;
+}  // namespace test
+
 namespace tcp {
 
 using boost::asio::ip::tcp;
 
 class Connection : public networking::Connection,
                    public std::enable_shared_from_this<Connection> {
+ public:
+  //! high-water marks of the write queue, messages are refused above them
+  static constexpr std::size_t MAX_QUEUED_MESSAGES = 4096;
+  static constexpr std::size_t MAX_QUEUED_BYTES = 16 * MAX_MESSAGE_SIZE;
+  //! maximum number of messages gathered in a single write
+  static constexpr std::size_t MAX_MESSAGES_PER_WRITE = 64;
+
  private:
+  struct OutgoingMessage {
+    std::shared_ptr<const Buffer> header;
+    std::shared_ptr<const Buffer> body;
+  };
+
   Buffer _header;
-  Buffer _buffer;
+  //! taken from the buffer pool for the lifetime of the connection
+  std::shared_ptr<Buffer> _buffer;
+  //! compressed bodies are read there and decompressed in _buffer
+  std::shared_ptr<Buffer> _compressed_buffer;
+  Decompressor _decompressor;
   std::shared_ptr<tcp::socket> _socket;
+  //! orders the handlers of this connection when the io_context has several
+  //! threads
+  boost::asio::strand<tcp::socket::executor_type> _strand;
+  //! signatures are verified there instead of in the io threads if set
+  boost::asio::thread_pool* _verifier;
+  //! the remote peer is shared with other threads, it is read and written
+  //! under the lock of the peers
+  messages::Peers* _peers;
   std::shared_ptr<messages::Peer> _remote_peer;
+  //! key of the remote peer, loaded once for all its messages
+  std::shared_ptr<const crypto::KeyPub> _remote_key_pub;
+  //! codec the remote peer can decompress, from its Hello or World
+  std::atomic<Compression> _remote_compression{Compression::NONE};
+
+  // Messages are written by a single async_write at a time so that messages
+  // sent from different threads are never interleaved on the wire
+  mutable std::mutex _write_mutex;
+  std::deque<OutgoingMessage> _write_queue;
+  std::vector<OutgoingMessage> _messages_in_flight;
+  std::size_t _queued_messages = 0;  //!< including the ones in flight
+  std::size_t _queued_bytes = 0;     //!< including the ones in flight
+  bool _is_writing = false;
 
   void read_header();
-  void read_body(std::size_t body_size);
+  void read_body(std::size_t body_size, Compression compression);
+  template <typename Compressions>
+  void set_remote_compression(const Compressions &compressions);
+  //! true if all the bodies of the message were received in the last
+  //! MESSAGE_TTL seconds, its signature is not checked then
+  bool is_received(const messages::Message &message) const;
+  void verify(std::shared_ptr<messages::Message> message);
+  void dispatch(std::shared_ptr<messages::Message> message, bool check);
+  void write();
+  void clear_write_queue();
   std::shared_ptr<Connection> ptr();
   void close();
 
  public:
-  Connection(const ID id, messages::Queue* queue,
+  Connection(const ID id, messages::Queue* queue, messages::Peers* peers,
              const std::shared_ptr<tcp::socket>& socket,
-             std::shared_ptr<messages::Peer> remote_peer);
+             std::shared_ptr<messages::Peer> remote_peer,
+             boost::asio::thread_pool* verifier = nullptr);
 
   std::shared_ptr<const tcp::socket> socket() const;
   void terminate(bool from_inside = true) const;
 
   void read();
 
-  bool send(std::shared_ptr<Buffer>& message);
+  /**
+   * \brief Queue a message to be written after the ones already queued
+   * \return false if the write queue is above its high-water marks
+   */
+  bool send(const std::shared_ptr<const Buffer>& header,
+            const std::shared_ptr<const Buffer>& body);
+  std::size_t queued_messages() const;
+  std::size_t queued_bytes() const;
   std::shared_ptr<messages::Peer> remote_peer() const;
+  //! codec to use for the frames sent to the remote peer
+  Compression remote_compression() const;
   const std::optional<IP> remote_ip() const;
   const std::optional<Port> remote_port() const;
   const std::optional<Port> local_port() const;
   const std::string ip() const;
   ~Connection();
+
+  friend class neuro::networking::test::Tcp;
 };
 }  // namespace tcp
 }  // namespace networking
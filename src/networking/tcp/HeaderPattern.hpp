@@ -1,16 +1,26 @@
 #ifndef NEURO_SRC_MESSAGES_HEADERPATTERN_HPP
 #define NEURO_SRC_MESSAGES_HEADERPATTERN_HPP
 
+#include <cstdint>
+
 namespace neuro {
 namespace networking {
 namespace tcp {
 
+//! codec of the body of a frame, the values match messages::Compression
+enum class Compression : uint32_t { NONE = 0, ZSTD = 1 };
+
 struct __attribute__((__packed__)) HeaderPattern {
-  uint32_t size;
-  ProtocolType type;
+  uint32_t size;  //!< size of the body on the wire
+  //! the signature is over the body before its compression
+  Compression compression;
   uint8_t signature[64];
 };
 
+// The compression takes the place of the former protocol type which was
+// always 0, so the frames of the peers that do not compress are unchanged
+static_assert(sizeof(HeaderPattern) == 72);
+
 }  // namespace tcp
 }  // namespace networking
 }  // namespace neuro
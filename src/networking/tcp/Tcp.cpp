@@ -1,8 +1,11 @@
 #include <assert.h>
+#include <algorithm>
+#include <cstdlib>
 #include <boost/asio/impl/io_context.ipp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/system/error_code.hpp>
 
+#include "common/BufferPool.hpp"
 #include "common/logger.hpp"
 #include "common/types.hpp"
 #include "config.pb.h"
@@ -11,6 +14,7 @@
 #include "messages/Peers.hpp"
 #include "messages/Queue.hpp"
 #include "networking/TransportLayer.hpp"
+#include "networking/tcp/Compression.hpp"
 #include "networking/tcp/Tcp.hpp"
 
 namespace neuro {
@@ -21,6 +25,7 @@ Tcp::Tcp(messages::Queue *queue, messages::Peers *peers, crypto::Ecc *keys,
          const messages::config::Networking &config)
     : TransportLayer(queue, peers, keys), _stopped(false),
       _listening_port(config.tcp().port()), _io_context(),
+      _verifier(std::max(config.tcp().verify_threads(), 1)),
       _resolver(_io_context),
       _acceptor(_io_context,
                 bai::tcp::endpoint(bai::tcp::v4(), _listening_port)),
@@ -32,11 +37,14 @@ Tcp::Tcp(messages::Queue *queue, messages::Peers *peers, crypto::Ecc *keys,
     LOG_DEBUG << "Waiting for acceptor to be open";
   }
   start_accept();
-  _io_context_thread = std::thread([this]() {
-    boost::system::error_code ec;
-    this->_io_context.run(ec);
-    LOG_INFO << __FILE__ << ":" << __LINE__ << "> io_context exited " << ec;
-  });
+  const auto io_threads = std::max(config.tcp().io_threads(), 1);
+  for (int i = 0; i < io_threads; i++) {
+    _io_context_threads.emplace_back([this]() {
+      boost::system::error_code ec;
+      this->_io_context.run(ec);
+      LOG_INFO << __FILE__ << ":" << __LINE__ << "> io_context exited " << ec;
+    });
+  }
 }
 
 void Tcp::start_accept() {
@@ -66,9 +74,10 @@ bool Tcp::connect(std::shared_ptr<messages::Peer> peer) {
     return false;
   }
 
+  const auto peer_copy = _peers->copy(*peer);
   bai::tcp::resolver resolver(_io_context);
-  bai::tcp::resolver::query query(peer->endpoint(),
-                                  std::to_string(peer->port()));
+  bai::tcp::resolver::query query(peer_copy.endpoint(),
+                                  std::to_string(peer_copy.port()));
   boost::system::error_code ec;
   bai::tcp::resolver::iterator endpoint_iterator = resolver.resolve(query, ec);
   if (ec) {
@@ -100,8 +109,8 @@ void Tcp::new_connection_from_remote(std::shared_ptr<bai::tcp::socket> socket,
 
     msg_header->set_connection_id(_current_id);
     auto remote_peer = std::make_shared<messages::Peer>(_config);
-    auto connection = std::make_shared<tcp::Connection>(_current_id, _queue,
-                                                        socket, remote_peer);
+    auto connection = std::make_shared<tcp::Connection>(
+        _current_id, _queue, _peers, socket, remote_peer, &_verifier);
     LOG_DEBUG << listening_port() << " new remote connection "
               << connection->ip() << ":"
               << connection->remote_port().value_or(0) << ":" << _current_id;
@@ -130,17 +139,20 @@ void Tcp::new_connection_local(std::shared_ptr<bai::tcp::socket> socket,
   auto msg_header = message->mutable_header();
   auto msg_body = message->add_bodies();
   if (!error) {
-    const auto previous_connection = _connections.find(peer->connection_id());
+    const auto peer_copy = _peers->copy(*peer);
+    const auto previous_connection =
+        _connections.find(peer_copy.connection_id());
     if (previous_connection != _connections.end()) {
-      LOG_WARNING << "connecting to a peer with previous connection " << *peer;
-      terminate(peer->connection_id());
+      LOG_WARNING << "connecting to a peer with previous connection "
+                  << peer_copy;
+      terminate(peer_copy.connection_id());
     }
     ++_current_id;
 
     msg_header->set_connection_id(_current_id);
-    msg_header->mutable_key_pub()->CopyFrom(peer->key_pub());
-    auto connection =
-        std::make_shared<tcp::Connection>(_current_id, _queue, socket, peer);
+    msg_header->mutable_key_pub()->CopyFrom(peer_copy.key_pub());
+    auto connection = std::make_shared<tcp::Connection>(
+        _current_id, _queue, _peers, socket, peer, &_verifier);
     LOG_DEBUG << listening_port() << " new local connection "
               << connection->ip() << ":"
               << connection->remote_port().value_or(0) << ":" << _current_id;
@@ -154,12 +166,14 @@ void Tcp::new_connection_local(std::shared_ptr<bai::tcp::socket> socket,
     _queue->push(message);
     connection->read();
   } else {
-    LOG_WARNING << "Could not create new connection to " << *peer << " : "
+    _peers->update(peer.get(),
+                   [](messages::Peer *peer) { peer->clear_connection_id(); });
+    const auto peer_copy = _peers->copy(*peer);
+    LOG_WARNING << "Could not create new connection to " << peer_copy << " : "
                 << error.message();
 
     auto connection_closed = msg_body->mutable_connection_closed();
-    peer->clear_connection_id();
-    connection_closed->mutable_peer()->CopyFrom(*peer);
+    connection_closed->mutable_peer()->CopyFrom(peer_copy);
     _queue->push(message);
   }
 }
@@ -171,9 +185,11 @@ bool Tcp::terminate(const Connection::ID id) {
     LOG_ERROR << "Terminate on connection not found " << id;
     return false;
   }
-  got->second->remote_peer()->set_status(messages::Peer::UNREACHABLE);
+  _peers->update(got->second->remote_peer().get(), [](messages::Peer *peer) {
+    peer->set_status(messages::Peer::UNREACHABLE);
+    peer->clear_connection_id();
+  });
   got->second->terminate(false);
-  got->second->remote_peer()->clear_connection_id();
   _connections.erase(got);
   return true;
 }
@@ -189,6 +205,8 @@ std::shared_ptr<messages::Peer> Tcp::find_peer(const Connection::ID id) {
 bool Tcp::serialize(const messages::Message &message, Buffer *header_tcp,
                     Buffer *body_tcp) const {
   // TODO: use 1 output buffer
+  // Pooled buffers are not initialized
+  header_tcp->assign(sizeof(tcp::HeaderPattern), 0);
   auto header_pattern =
       reinterpret_cast<tcp::HeaderPattern *>(header_tcp->data());
   messages::to_buffer(message, body_tcp);
@@ -205,6 +223,41 @@ bool Tcp::serialize(const messages::Message &message, Buffer *header_tcp,
   return true;
 }
 
+bool Tcp::compress(const Buffer &header_tcp, const Buffer &body_tcp,
+                   Buffer *compressed_header_tcp,
+                   Buffer *compressed_body_tcp) const {
+  if (!_config.tcp().compression()) {
+    return false;
+  }
+  // Frames are compressed by the threads sending them, each reusing its own
+  // context
+  thread_local tcp::Compressor compressor;
+  if (!compressor.compress(body_tcp, compressed_body_tcp,
+                           _config.tcp().compression_level())) {
+    return false;
+  }
+  compressed_header_tcp->copy(header_tcp);
+  auto header_pattern =
+      reinterpret_cast<tcp::HeaderPattern *>(compressed_header_tcp->data());
+  header_pattern->size = compressed_body_tcp->size();
+  header_pattern->compression = tcp::Compression::ZSTD;
+  return true;
+}
+
+TransportLayer::SendResult Tcp::send_frame(
+    const std::shared_ptr<tcp::Connection> &connection,
+    const std::shared_ptr<const Buffer> &header_tcp,
+    const std::shared_ptr<const Buffer> &body_tcp) const {
+  if (!connection->remote_port()) {
+    LOG_WARNING << "not sending message because there is no port";
+    return SendResult::FAILED;
+  }
+  if (!connection->send(header_tcp, body_tcp)) {
+    return SendResult::FAILED;
+  }
+  return SendResult::ALL_GOOD;
+}
+
 /**
  * send a message to a specific peer
  * \param message a message to send
@@ -218,44 +271,90 @@ TransportLayer::SendResult Tcp::send(const messages::Message &message,
     LOG_WARNING << "not sending message because could not find connection";
     return SendResult::FAILED;
   }
-  const auto port_opt = connection->remote_port();
-  if (!port_opt) {
-    LOG_WARNING << "not sending message because there is no port";
-    return SendResult::FAILED;
-  }
   LOG_DEBUG << "Sending unicast [" << this->listening_port() << " -> "
-            << *port_opt << "]: >>" << message;
+            << connection->remote_port().value_or(0) << "]: >>" << message;
 
-  auto header_tcp =
-      std::make_shared<Buffer>(sizeof(networking::tcp::HeaderPattern), 0);
-  auto body_tcp = std::make_shared<Buffer>();
+  auto &buffer_pool = BufferPool::instance();
+  auto header_tcp = buffer_pool.acquire(sizeof(networking::tcp::HeaderPattern));
+  auto body_tcp = buffer_pool.acquire(message.ByteSizeLong());
   if (!serialize(message, header_tcp.get(), body_tcp.get())) {
     LOG_WARNING << "not sending message because we failed to serialize";
     return SendResult::FAILED;
   }
-  if (connection->send(header_tcp) && connection->send(body_tcp)) {
-    return SendResult::ALL_GOOD;
-  } else {
-    return SendResult::FAILED;
+  if (connection->remote_compression() == tcp::Compression::ZSTD) {
+    auto compressed_header_tcp =
+        buffer_pool.acquire(sizeof(networking::tcp::HeaderPattern));
+    auto compressed_body_tcp = buffer_pool.acquire(body_tcp->size());
+    if (compress(*header_tcp, *body_tcp, compressed_header_tcp.get(),
+                 compressed_body_tcp.get())) {
+      return send_frame(connection, compressed_header_tcp,
+                        compressed_body_tcp);
+    }
   }
+  return send_frame(connection, header_tcp, body_tcp);
 }
 
 TransportLayer::SendResult
 Tcp::send_one(const messages::Message &message) const {
-  auto peer_it = _peers->begin(messages::Peer::CONNECTED);
-  if (peer_it != _peers->end()) {
-    return send(message, peer_it->connection_id());
+  const auto connected_peers = _peers->connected_peers_copy();
+  if (connected_peers.empty()) {
+    return SendResult::FAILED;
   }
-  return SendResult::FAILED;
+  const auto &peer = connected_peers[rand() % connected_peers.size()];
+  return send(message, peer.connection_id());
 }
 
+/**
+ * send a message to all connected peers, the message is serialized and signed
+ * once and the same frame is queued on every connection
+ * \param message a message to send
+ * \return failure, one_or_more_sent or all_good
+ */
 TransportLayer::SendResult
 Tcp::send_all(const messages::Message &message) const {
-  const auto connected_peers = _peers->connected_peers();
+  const auto connected_peers = _peers->connected_peers_copy();
+  if (connected_peers.empty()) {
+    return SendResult::FAILED;
+  }
+  LOG_DEBUG << "Sending broadcast [" << this->listening_port() << " -> "
+            << connected_peers.size() << " peers]: >>" << message;
+
+  auto &buffer_pool = BufferPool::instance();
+  auto header_tcp = buffer_pool.acquire(sizeof(networking::tcp::HeaderPattern));
+  auto body_tcp = buffer_pool.acquire(message.ByteSizeLong());
+  if (!serialize(message, header_tcp.get(), body_tcp.get())) {
+    LOG_WARNING << "not sending message because we failed to serialize";
+    return SendResult::FAILED;
+  }
+
+  // The frame is compressed once, for the first peer that supports it
+  std::shared_ptr<Buffer> compressed_header_tcp;
+  std::shared_ptr<Buffer> compressed_body_tcp;
+  bool is_compressed = false;
+  bool compression_tried = false;
+
   bool one_good = false;
   bool one_failed = false;
-  for (const auto peer : connected_peers) {
-    if (send(message, peer->connection_id()) == SendResult::ALL_GOOD) {
+  for (const auto &peer : connected_peers) {
+    const auto connection = find(peer.connection_id());
+    const bool compress_frame =
+        connection &&
+        connection->remote_compression() == tcp::Compression::ZSTD;
+    if (compress_frame && !compression_tried) {
+      compression_tried = true;
+      compressed_header_tcp =
+          buffer_pool.acquire(sizeof(networking::tcp::HeaderPattern));
+      compressed_body_tcp = buffer_pool.acquire(body_tcp->size());
+      is_compressed = compress(*header_tcp, *body_tcp,
+                               compressed_header_tcp.get(),
+                               compressed_body_tcp.get());
+    }
+    const bool send_compressed = compress_frame && is_compressed;
+    if (connection &&
+        send_frame(connection,
+                   send_compressed ? compressed_header_tcp : header_tcp,
+                   send_compressed ? compressed_body_tcp : body_tcp) ==
+            SendResult::ALL_GOOD) {
       one_good = true;
     } else {
       one_failed = true;
@@ -293,17 +392,17 @@ void Tcp::clean_old_connections(int delta) {
   std::unique_lock lock_connection(_connections_mutex);
   const auto current_time = ::neuro::time() - delta;
   for (auto &[_, connection] : _connections) {
-    auto remote_peer = connection->remote_peer();
+    const auto remote_peer = _peers->copy(*connection->remote_peer());
     if ((connection->init_ts() < current_time) &&
-        (remote_peer->status() != messages::Peer::CONNECTED)) {
+        (remote_peer.status() != messages::Peer::CONNECTED)) {
       connection->terminate();
     }
-    if (remote_peer->status() == messages::Peer::CONNECTED &&
-        remote_peer->next_update().data() <
+    if (remote_peer.status() == messages::Peer::CONNECTED &&
+        remote_peer.next_update().data() <
             static_cast<int32_t>(std::time(nullptr))) {
       LOG_DEBUG
           << "Terminating connection, did not receive ping for too long from "
-          << *remote_peer;
+          << remote_peer;
       connection->terminate();
     }
   }
@@ -326,23 +425,33 @@ std::vector<std::shared_ptr<messages::Peer>> Tcp::remote_peers() const {
 }
 
 void Tcp::stop() {
-  std::unique_lock lock_connection(_connections_mutex);
-  if (!_stopped) {
-    _stopped = true;
-    _io_context.post([this]() { _acceptor.close(); });
-    for (auto &[_, connection] : _connections) {
-      connection->terminate(false);
+  // The io threads are joined without the lock, their handlers may need it
+  ConnectionById connections;
+  {
+    std::unique_lock lock_connection(_connections_mutex);
+    if (_stopped) {
+      return;
     }
-    _io_context.stop();
-
-    join();
+    _stopped = true;
+    connections.swap(_connections);
   }
+  _io_context.post([this]() { _acceptor.close(); });
+  for (auto &[_, connection] : connections) {
+    connection->terminate(false);
+  }
+  _io_context.stop();
+
+  join();
 }
 
 void Tcp::join() {
-  if (_io_context_thread.joinable()) {
-    _io_context_thread.join();
+  for (auto &io_context_thread : _io_context_threads) {
+    if (io_context_thread.joinable()) {
+      io_context_thread.join();
+    }
   }
+  _verifier.stop();
+  _verifier.join();
   LOG_DEBUG << this << " TCP joined";
 }
 
@@ -350,14 +459,14 @@ std::string Tcp::pretty_connections() {
   std::stringstream result;
   result << listening_port() << " pretty connections";
   for (const auto &[id, connection] : _connections) {
-    auto peer = connection->remote_peer();
-    result << " " << id << ":" << peer->endpoint() << ":" << peer->port() << ":"
-           << _Peer_Status_Name(peer->status()) << ":" << peer->connection_id();
-    if (peer->has_connection_id() && id != peer->connection_id()) {
+    const auto peer = _peers->copy(*connection->remote_peer());
+    result << " " << id << ":" << peer.endpoint() << ":" << peer.port() << ":"
+           << _Peer_Status_Name(peer.status()) << ":" << peer.connection_id();
+    if (peer.has_connection_id() && id != peer.connection_id()) {
       std::stringstream m;
       m << "Connection id " << id
         << " does not match the connection_id in the peer " << result.str()
-        << "; " << *peer;
+        << "; " << peer;
       throw std::runtime_error(m.str());
     }
   }
@@ -36,10 +36,11 @@ class Tcp : public TransportLayer {
   std::atomic<bool> _stopped;
   Port _listening_port;
   boost::asio::io_context _io_context;
+  boost::asio::thread_pool _verifier;
   bai::tcp::resolver _resolver;
   bai::tcp::acceptor _acceptor;
   std::shared_ptr<bai::tcp::socket> _new_socket;
-  std::thread _io_context_thread;
+  std::vector<std::thread> _io_context_threads;
   ConnectionById _connections;
   mutable std::recursive_mutex _connections_mutex;
   const messages::config::Networking &_config;
@@ -54,6 +55,19 @@ class Tcp : public TransportLayer {
   bool serialize(const messages::Message &message, Buffer *header_tcp,
                  Buffer *body_tcp) const;
 
+  /**
+   * \brief Build the compressed frame of a serialized one, the signature of
+   * the uncompressed body is kept
+   * \return false if the compression is disabled or not worth it
+   */
+  bool compress(const Buffer &header_tcp, const Buffer &body_tcp,
+                Buffer *compressed_header_tcp,
+                Buffer *compressed_body_tcp) const;
+
+  SendResult send_frame(const std::shared_ptr<tcp::Connection> &connection,
+                        const std::shared_ptr<const Buffer> &header_tcp,
+                        const std::shared_ptr<const Buffer> &body_tcp) const;
+
   void start_accept();
   void accept(const boost::system::error_code &error);
   void stop();
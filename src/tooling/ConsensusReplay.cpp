@@ -0,0 +1,156 @@
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include "common/logger.hpp"
+#include "messages/Message.hpp"
+#include "tooling/ConsensusReplay.hpp"
+
+namespace neuro {
+namespace tooling {
+
+std::chrono::nanoseconds ConsensusReplay::Stats::total() const {
+  return insert + verify + main_branch + pii;
+}
+
+double ConsensusReplay::Stats::blocks_per_second() const {
+  const auto seconds = std::chrono::duration<double>(total()).count();
+  return seconds > 0 ? blocks / seconds : 0;
+}
+
+double ConsensusReplay::Stats::transactions_per_second() const {
+  const auto seconds = std::chrono::duration<double>(total()).count();
+  return seconds > 0 ? transactions / seconds : 0;
+}
+
+ConsensusReplay::ConsensusReplay(const std::string &db_url,
+                                 const std::string &db_name,
+                                 const messages::Block &block0,
+                                 const consensus::Config &config)
+    : _ledger(std::make_shared<ledger::LedgerMongodb>(db_url, db_name, block0)),
+      _consensus(std::make_shared<consensus::Consensus>(
+          _ledger, _keys, config, [](const messages::Block &block) {},
+          [](const messages::Block &block) {}, false)) {}
+
+bool ConsensusReplay::add_block(const messages::Block &block) {
+  // Same steps as Consensus::add_block but timed one by one
+  const auto t0 = Timer::now();
+  if (!_consensus->check_transactions_order(block) ||
+      !_ledger->insert_block(block) || !_consensus->add_double_mining(block)) {
+    LOG_ERROR << "Failed to insert block " << block.header().id();
+    return false;
+  }
+  const auto t1 = Timer::now();
+  if (!_consensus->verify_blocks()) {
+    LOG_ERROR << "Failed to verify block " << block.header().id();
+    return false;
+  }
+  const auto t2 = Timer::now();
+  if (!_ledger->update_main_branch()) {
+    LOG_ERROR << "Failed to update the main branch with block "
+              << block.header().id();
+    return false;
+  }
+  const auto t3 = Timer::now();
+  std::vector<messages::Assembly> assemblies;
+  _ledger->get_assemblies_to_compute(&assemblies);
+  for (const auto &assembly : assemblies) {
+    if (!_consensus->compute_assembly_pii(assembly)) {
+      LOG_ERROR << "Failed to compute the pii of assembly " << assembly.id();
+      return false;
+    }
+    _stats.assemblies++;
+  }
+  const auto t4 = Timer::now();
+
+  _stats.blocks++;
+  _stats.transactions += block.transactions_size();
+  _stats.insert += t1 - t0;
+  _stats.verify += t2 - t1;
+  _stats.main_branch += t3 - t2;
+  _stats.pii += t4 - t3;
+  return true;
+}
+
+bool ConsensusReplay::replay(std::istream *input) {
+  while (input->peek() != std::char_traits<char>::eof()) {
+    const auto block = read_block(input);
+    if (!block) {
+      LOG_ERROR << "Failed to read block after " << _stats.blocks << " blocks";
+      return false;
+    }
+    if (!add_block(*block)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const ConsensusReplay::Stats &ConsensusReplay::stats() const { return _stats; }
+
+std::shared_ptr<ledger::LedgerMongodb> ConsensusReplay::ledger() const {
+  return _ledger;
+}
+
+uint64_t ConsensusReplay::dump(const ledger::Ledger &ledger,
+                               std::ostream *output) {
+  const auto height = ledger.height();
+  uint64_t nb_blocks = 0;
+  for (messages::BlockHeight i = 0; i <= height; i++) {
+    messages::Block block;
+    if (!ledger.get_block(i, &block)) {
+      LOG_WARNING << "Missing main branch block at height " << i;
+      break;
+    }
+    // The ledger does not keep the transactions order
+    messages::sort_transactions(&block);
+    google::protobuf::util::SerializeDelimitedToOstream(block, output);
+    nb_blocks++;
+  }
+  return nb_blocks;
+}
+
+std::optional<messages::Block> ConsensusReplay::read_block(
+    std::istream *input) {
+  // The size is a base 128 varint, read it byte by byte so that nothing after
+  // the block is consumed from the stream
+  uint64_t size = 0;
+  for (int shift = 0;; shift += 7) {
+    const auto byte = input->get();
+    if (byte == std::char_traits<char>::eof() || shift >= 64) {
+      return std::nullopt;
+    }
+    size |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      break;
+    }
+  }
+  std::string buffer(size, '\0');
+  if (!input->read(buffer.data(), static_cast<std::streamsize>(size))) {
+    return std::nullopt;
+  }
+  messages::Block block;
+  if (!block.ParseFromString(buffer)) {
+    return std::nullopt;
+  }
+  return block;
+}
+
+std::ostream &operator<<(std::ostream &os,
+                         const ConsensusReplay::Stats &stats) {
+  const auto ms = [](const std::chrono::nanoseconds &duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  };
+  os << "blocks: " << stats.blocks << std::endl
+     << "transactions: " << stats.transactions << std::endl
+     << "assemblies: " << stats.assemblies << std::endl
+     << "insert: " << ms(stats.insert) << " ms" << std::endl
+     << "verify: " << ms(stats.verify) << " ms" << std::endl
+     << "main_branch: " << ms(stats.main_branch) << " ms" << std::endl
+     << "pii: " << ms(stats.pii) << " ms" << std::endl
+     << "total: " << ms(stats.total()) << " ms" << std::endl
+     << "blocks/s: " << stats.blocks_per_second() << std::endl
+     << "transactions/s: " << stats.transactions_per_second() << std::endl;
+  return os;
+}
+
+}  // namespace tooling
+}  // namespace neuro
@@ -0,0 +1,86 @@
+#ifndef NEURO_SRC_TOOLING_CONSENSUS_REPLAY_HPP
+#define NEURO_SRC_TOOLING_CONSENSUS_REPLAY_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+
+#include "common/types.hpp"
+#include "consensus/Config.hpp"
+#include "consensus/Consensus.hpp"
+#include "crypto/Ecc.hpp"
+#include "ledger/LedgerMongodb.hpp"
+#include "messages.pb.h"
+
+namespace neuro {
+namespace tooling {
+
+/**
+ * \brief Replay a recorded chain through the consensus on a fresh ledger
+ *
+ * The chain is a dump of length delimited blocks starting with the block0.
+ * Every stage of the block processing is timed separately so that the
+ * consensus throughput can be measured without the cost of generating the
+ * blocks.
+ */
+class ConsensusReplay {
+ public:
+  struct Stats {
+    uint64_t blocks = 0;
+    uint64_t transactions = 0;
+    uint64_t assemblies = 0;
+    std::chrono::nanoseconds insert{0};       //!< insert_block, double mining
+    std::chrono::nanoseconds verify{0};       //!< verify_blocks
+    std::chrono::nanoseconds main_branch{0};  //!< update_main_branch
+    std::chrono::nanoseconds pii{0};          //!< compute_assembly_pii
+
+    std::chrono::nanoseconds total() const;
+    double blocks_per_second() const;
+    double transactions_per_second() const;
+  };
+
+ private:
+  const std::vector<crypto::Ecc> _keys;
+  std::shared_ptr<ledger::LedgerMongodb> _ledger;
+  std::shared_ptr<consensus::Consensus> _consensus;
+  Stats _stats;
+
+ public:
+  ConsensusReplay(const std::string &db_url, const std::string &db_name,
+                  const messages::Block &block0,
+                  const consensus::Config &config);
+
+  /**
+   * \brief Add a block and compute the assemblies it makes available
+   * \return false if the block was refused by the consensus
+   */
+  bool add_block(const messages::Block &block);
+
+  /**
+   * \brief Replay every block of the stream after the block0
+   * \return false if a block could not be read or was refused
+   */
+  bool replay(std::istream *input);
+
+  const Stats &stats() const;
+
+  std::shared_ptr<ledger::LedgerMongodb> ledger() const;
+
+  /**
+   * \brief Write the main branch of a ledger as length delimited blocks
+   * \return the number of blocks written
+   */
+  static uint64_t dump(const ledger::Ledger &ledger, std::ostream *output);
+
+  static std::optional<messages::Block> read_block(std::istream *input);
+};
+
+std::ostream &operator<<(std::ostream &os,
+                         const ConsensusReplay::Stats &stats);
+
+}  // namespace tooling
+}  // namespace neuro
+
+#endif /* NEURO_SRC_TOOLING_CONSENSUS_REPLAY_HPP */
@@ -18,7 +18,6 @@ static consensus::Config config{
     .max_transaction_per_block = 300,
     .update_heights_sleep = 1s,
     .compute_pii_sleep = 1s,
-    .miner_sleep = 10ms,
     .integrity_block_reward = 1,
     .integrity_double_mining = -40,
     .integrity_denunciation_reward = 1,
@@ -78,8 +77,7 @@ messages::Transaction Simulator::random_transaction() const {
  */
 messages::Block Simulator::new_block(
     int nb_transactions, const messages::TaggedBlock &last_block) const {
-  messages::Block block, block0;
-  ledger->get_block(0, &block0);
+  messages::Block block;
 
   for (int i = 0; i < nb_transactions; i++) {
     auto transaction = random_transaction();
@@ -103,9 +101,8 @@ messages::Block Simulator::new_block(
   assert(consensus->get_block_writer(assembly, height, &key_pub));
   uint32_t miner_index = key_pubs_indexes.at(key_pub);
   auto header = block.mutable_header();
-  header->mutable_timestamp()->set_data(block0.header().timestamp().data() +
-                                        height *
-                                            consensus->config().block_period);
+  header->mutable_timestamp()->set_data(
+      consensus->chain_parameters().slot_start(height));
   header->mutable_previous_block_hash()->CopyFrom(
       last_block.block().header().id());
   header->set_height(height);
@@ -0,0 +1,96 @@
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+
+#include "common/logger.hpp"
+#include "consensus/Config.hpp"
+#include "ledger/LedgerMongodb.hpp"
+#include "tooling/ConsensusReplay.hpp"
+
+namespace po = boost::program_options;
+
+namespace neuro {
+namespace tooling {
+
+int main(int argc, char *argv[]) {
+  const consensus::Config default_config;
+  po::options_description description("Allowed options");
+  description.add_options()("help,h", "Show help message")(
+      "filename,f", po::value<std::string>()->default_value("blocks.dump"),
+      "Length delimited blocks starting with the block0")(
+      "db-url",
+      po::value<std::string>()->default_value("mongodb://mongo:27017"),
+      "Mongodb url")(
+      "db-name", po::value<std::string>()->default_value("consensus_replay"),
+      "Database used for the replay, it is emptied first")(
+      "record", po::value<std::string>(),
+      "Write the main branch of this database to the file instead of "
+      "replaying it")(
+      "blocks-per-assembly",
+      po::value<uint32_t>()->default_value(default_config.blocks_per_assembly))(
+      "members-per-assembly",
+      po::value<uint32_t>()->default_value(
+          default_config.members_per_assembly))(
+      "block-period",
+      po::value<uint32_t>()->default_value(default_config.block_period))(
+      "block-reward", po::value<uint64_t>()->default_value(
+                          default_config.block_reward.value()));
+  po::variables_map options;
+  po::store(po::parse_command_line(argc, argv, description), options);
+  try {
+    po::notify(options);
+  } catch (po::error &e) {
+    return 1;
+  }
+
+  if (options.count("help") != 0u) {
+    std::cout << description << std::endl;
+    return 1;
+  }
+
+  const auto filename = options["filename"].as<std::string>();
+  const auto db_url = options["db-url"].as<std::string>();
+
+  if (options.count("record") != 0u) {
+    std::ofstream output(filename, std::ios::binary);
+    if (!output.is_open()) {
+      LOG_ERROR << "Could not open file " << filename;
+      return 1;
+    }
+    const ledger::LedgerMongodb ledger(db_url,
+                                       options["record"].as<std::string>());
+    const auto nb_blocks = ConsensusReplay::dump(ledger, &output);
+    std::cout << "recorded " << nb_blocks << " blocks in " << filename
+              << std::endl;
+    return 0;
+  }
+
+  std::ifstream input(filename, std::ios::binary);
+  if (!input.is_open()) {
+    LOG_ERROR << "Could not open file " << filename;
+    return 1;
+  }
+  const auto block0 = ConsensusReplay::read_block(&input);
+  if (!block0) {
+    LOG_ERROR << "Could not read the block0 from " << filename;
+    return 1;
+  }
+
+  auto config = default_config;
+  config.blocks_per_assembly = options["blocks-per-assembly"].as<uint32_t>();
+  config.members_per_assembly = options["members-per-assembly"].as<uint32_t>();
+  config.block_period = options["block-period"].as<uint32_t>();
+  config.block_reward =
+      messages::NCCAmount{options["block-reward"].as<uint64_t>()};
+
+  ConsensusReplay replay(db_url, options["db-name"].as<std::string>(), *block0,
+                         config);
+  const bool is_replayed = replay.replay(&input);
+  std::cout << replay.stats();
+  return is_replayed ? 0 : 1;
+}
+
+}  // namespace tooling
+}  // namespace neuro
+
+int main(int argc, char *argv[]) { return neuro::tooling::main(argc, argv); }
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "common/BufferPool.hpp"
+#include "common/logger.hpp"
+#include "messages/Message.hpp"
+#include "networking/tcp/HeaderPattern.hpp"
+
+// Count the heap allocations to compare the send paths, this test has its own
+// executable so that no other test runs with this operator new
+static std::atomic<std::size_t> nb_allocations{0};
+
+void *operator new(std::size_t size) {
+  nb_allocations++;
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace neuro {
+namespace test {
+
+TEST(BufferPool, uninitialized_resize) {
+  Buffer buffer(4, 'A');
+  buffer.resize(2);
+  ASSERT_EQ(buffer, Buffer(2, 'A'));
+  buffer.resize(8, 'B');
+  ASSERT_EQ(buffer.size(), 8);
+  ASSERT_EQ(buffer[7], 'B');
+}
+
+TEST(BufferPool, acquire) {
+  BufferPool pool(1);
+  Buffer *data = nullptr;
+  {
+    auto buffer = pool.acquire(100);
+    ASSERT_EQ(buffer->size(), 100);
+    ASSERT_GE(buffer->capacity(), BufferPool::capacity(0));
+    data = buffer.get();
+  }
+  ASSERT_EQ(pool.allocations(), 1);
+  ASSERT_EQ(pool.size(), 1);
+
+  // Same size class
+  {
+    auto buffer = pool.acquire(200);
+    ASSERT_EQ(buffer.get(), data);
+    ASSERT_EQ(buffer->size(), 200);
+    ASSERT_EQ(pool.size(), 0);
+    auto other_buffer = pool.acquire(200);
+    ASSERT_NE(other_buffer.get(), data);
+  }
+  ASSERT_EQ(pool.allocations(), 2);
+  ASSERT_EQ(pool.reuses(), 1);
+  // Only one buffer per class is kept
+  ASSERT_EQ(pool.size(), 1);
+
+  // Bigger size class
+  {
+    auto buffer = pool.acquire(BufferPool::capacity(0) + 1);
+    ASSERT_NE(buffer.get(), data);
+    ASSERT_GE(buffer->capacity(), BufferPool::capacity(1));
+  }
+  ASSERT_EQ(pool.allocations(), 3);
+  ASSERT_EQ(pool.size(), 2);
+
+  // Too big to be pooled
+  {
+    auto buffer = pool.acquire(
+        BufferPool::capacity(BufferPool::NB_SIZE_CLASSES - 1) + 1);
+  }
+  ASSERT_EQ(pool.size(), 2);
+}
+
+TEST(BufferPool, allocations_per_message) {
+  const int nb_messages = 1000;
+  messages::Message message;
+  message.add_bodies()->mutable_get_peers();
+  const auto header_size = sizeof(networking::tcp::HeaderPattern);
+
+  // What Tcp::send used to do for each message
+  auto allocations = nb_allocations.load();
+  for (int i = 0; i < nb_messages; i++) {
+    auto header_tcp = std::make_shared<Buffer>(header_size, 0);
+    auto body_tcp = std::make_shared<Buffer>();
+    messages::to_buffer(message, body_tcp.get());
+  }
+  const auto before =
+      static_cast<double>(nb_allocations - allocations) / nb_messages;
+
+  BufferPool pool;
+  allocations = nb_allocations.load();
+  for (int i = 0; i < nb_messages; i++) {
+    auto header_tcp = pool.acquire(header_size);
+    auto body_tcp = pool.acquire(message.ByteSizeLong());
+    messages::to_buffer(message, body_tcp.get());
+  }
+  const auto after =
+      static_cast<double>(nb_allocations - allocations) / nb_messages;
+
+  LOG_INFO << "Allocations per message before " << before << " after "
+           << after;
+  ASSERT_EQ(pool.allocations(), 2);
+  ASSERT_LT(after, before);
+}
+
+}  // namespace test
+}  // namespace neuro
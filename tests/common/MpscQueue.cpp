@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "common/MpscQueue.hpp"
+
+namespace neuro {
+namespace test {
+
+TEST(MpscQueue, order) {
+  MpscQueue<int> queue;
+  int value;
+  ASSERT_FALSE(queue.pop(&value));
+  for (int i = 0; i < 10; i++) {
+    queue.push(i);
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(queue.pop(&value));
+    ASSERT_EQ(value, i);
+  }
+  ASSERT_FALSE(queue.pop(&value));
+}
+
+TEST(MpscQueue, producers) {
+  const int nb_producers = 4;
+  const int values_per_producer = 100000;
+  MpscQueue<std::pair<int, int>> queue;
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < nb_producers; producer++) {
+    producers.emplace_back([&queue, producer]() {
+      for (int i = 0; i < values_per_producer; i++) {
+        queue.push({producer, i});
+      }
+    });
+  }
+
+  // Each producer's values are popped in the order they were pushed
+  std::vector<int> next_values(nb_producers, 0);
+  int nb_values = 0;
+  std::pair<int, int> value;
+  while (nb_values < nb_producers * values_per_producer) {
+    if (!queue.pop(&value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(value.second, next_values[value.first]);
+    next_values[value.first]++;
+    nb_values++;
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  ASSERT_FALSE(queue.pop(&value));
+}
+
+TEST(MpscQueue, destructor) {
+  // The values left are released
+  auto value = std::make_shared<int>(0);
+  {
+    MpscQueue<std::shared_ptr<int>> queue;
+    queue.push(value);
+    queue.push(value);
+    ASSERT_EQ(value.use_count(), 3);
+  }
+  ASSERT_EQ(value.use_count(), 1);
+}
+
+}  // namespace test
+}  // namespace neuro
@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+
+#include "src/consensus/ChainParameters.hpp"
+
+namespace neuro {
+namespace consensus {
+namespace tests {
+
+TEST(ChainParameters, slots) {
+  messages::Block block0;
+  block0.mutable_header()->mutable_timestamp()->set_data(1000);
+  Config config;
+  config.block_period = 3;
+  config.blocks_per_assembly = 10;
+  const ChainParameters chain_parameters(block0, config);
+
+  ASSERT_EQ(chain_parameters.genesis_timestamp(), 1000);
+  ASSERT_EQ(chain_parameters.slot_start(0), 1000);
+  ASSERT_EQ(chain_parameters.slot_start(5), 1015);
+  ASSERT_EQ(chain_parameters.slot_end(5), 1018);
+  ASSERT_EQ(chain_parameters.height_at(1015), 5);
+  ASSERT_EQ(chain_parameters.height_at(1017), 5);
+  ASSERT_EQ(chain_parameters.height_at(1018), 6);
+  ASSERT_EQ(chain_parameters.assembly_height(9), 0);
+  ASSERT_EQ(chain_parameters.assembly_height(10), 1);
+  ASSERT_EQ(chain_parameters.first_height(2), 20);
+  ASSERT_EQ(chain_parameters.last_height(2), 29);
+}
+
+}  // namespace tests
+}  // namespace consensus
+}  // namespace neuro
@@ -213,6 +213,91 @@ class Consensus : public testing::Test {
     }
   }
 
+  void test_prepare_block() {
+    messages::TaggedBlock tagged_block;
+    messages::Assembly assembly_minus_1, assembly_minus_2;
+    bool include_transactions = false;
+    ASSERT_TRUE(ledger->get_last_block(&tagged_block, include_transactions));
+    ledger->get_assembly(tagged_block.previous_assembly_id(),
+                         &assembly_minus_1);
+    ledger->get_assembly(assembly_minus_1.previous_assembly_id(),
+                         &assembly_minus_2);
+    messages::_KeyPub key_pub;
+    ASSERT_TRUE(consensus->get_block_writer(assembly_minus_2, 1, &key_pub));
+    std::size_t key_pub_index = 0;
+    while (simulator.key_pubs[key_pub_index] != key_pub) {
+      key_pub_index++;
+    }
+    const auto &keys = simulator.keys[key_pub_index];
+
+    // A prepared block only misses its timestamp, id and signature
+    messages::Block block;
+    ASSERT_TRUE(consensus->prepare_block(keys, 1, &block));
+    ASSERT_EQ(block.header().height(), 1);
+    ASSERT_EQ(block.coinbase().outputs_size(), 1);
+    ASSERT_FALSE(block.header().has_id());
+    ASSERT_FALSE(block.header().has_author());
+    ASSERT_FALSE(block.header().has_timestamp());
+
+    consensus->finalize_block(keys, &block);
+    ASSERT_TRUE(block.header().has_id());
+    ASSERT_TRUE(block.header().has_author());
+    ASSERT_TRUE(block.header().has_timestamp());
+    tagged_block.mutable_block()->CopyFrom(block);
+    ASSERT_TRUE(consensus->check_block_id(tagged_block));
+    ASSERT_TRUE(consensus->check_block_author(tagged_block));
+  }
+
+  void test_block_template_interval() {
+    consensus->update_block_template(1, 0);
+    ASSERT_TRUE(consensus->_block_template);
+    const auto first_time = consensus->_block_template_time;
+
+    // A new transaction does not rebuild the template before the interval
+    consensus->set_block_template_dirty();
+    consensus->update_block_template(1, 0);
+    ASSERT_EQ(consensus->_block_template_time, first_time);
+    ASSERT_TRUE(consensus->_is_block_template_dirty);
+
+    std::this_thread::sleep_for(consensus->config().block_template_interval);
+    consensus->update_block_template(1, 0);
+    ASSERT_GT(consensus->_block_template_time, first_time);
+    ASSERT_FALSE(consensus->_is_block_template_dirty);
+  }
+
+  void test_verify_invalid_chain() {
+    // Regression benchmark: an invalid block followed by a long chain of
+    // descendants should be invalidated in a single pass of verify_blocks
+    const int nb_blocks = 1000;
+    messages::TaggedBlock last_block;
+    ASSERT_TRUE(ledger->get_last_block(&last_block));
+    auto block = simulator.new_block(last_block);
+
+    // The coinbase does not match its id anymore
+    block.mutable_coinbase()->mutable_outputs(0)->mutable_value()->set_value(1);
+    messages::set_block_hash(&block);
+    ASSERT_TRUE(ledger->insert_block(block));
+    block.clear_transactions();
+    for (int i = 1; i < nb_blocks; i++) {
+      block.mutable_header()->mutable_previous_block_hash()->CopyFrom(
+          block.header().id());
+      block.mutable_header()->set_height(block.header().height() + 1);
+      messages::set_block_hash(&block);
+      ASSERT_TRUE(ledger->insert_block(block));
+    }
+
+    const auto t0 = Timer::now();
+    ASSERT_FALSE(consensus->verify_blocks());
+    const auto elapsed = Timer::now() - t0;
+    LOG_INFO << "verify_blocks invalidated " << nb_blocks << " blocks in "
+             << elapsed.count() / 1E6 << " ms ("
+             << nb_blocks * 1E9 / elapsed.count() << " blocks/s)";
+
+    ASSERT_EQ(ledger->get_blocks(messages::Branch::INVALID).size(), nb_blocks);
+    ASSERT_EQ(ledger->get_blocks(messages::Branch::UNVERIFIED).size(), 0);
+    ASSERT_EQ(ledger->height(), 0);
+  }
+
   uint64_t total_money() {
     uint64_t total = 0;
     for (const auto &key_pub : simulator.key_pubs) {
@@ -562,6 +647,45 @@ class Consensus : public testing::Test {
           counts[simulator.keys.at(i).key_pub()]);
     }
   }
+
+  std::size_t nb_heights_to_write() {
+    std::lock_guard lock(consensus->_heights_to_write_mutex);
+    return consensus->_heights_to_write.size();
+  }
+
+  void test_miner_schedule() {
+    // The miner sleeps until the slot of the first height to write starts
+    const auto current_height = consensus->_chain_parameters->current_height();
+    {
+      std::lock_guard lock(consensus->_heights_to_write_mutex);
+      consensus->_heights_to_write = {{current_height + 1000, 0}};
+    }
+    consensus->start_miner_thread();
+    ASSERT_TRUE(consensus->_is_miner_running);
+    std::this_thread::sleep_for(200ms);
+    ASSERT_EQ(nb_heights_to_write(), 1);
+
+    // It is woken up when a height whose slot started is scheduled first,
+    // the slot of that one is over so it is dropped without being mined
+    {
+      std::lock_guard lock(consensus->_heights_to_write_mutex);
+      consensus->_heights_to_write.insert(
+          consensus->_heights_to_write.begin(), {current_height - 1, 0});
+    }
+    consensus->_heights_to_write_cv.notify_all();
+    for (int i = 0; i < 50 && nb_heights_to_write() > 1; i++) {
+      std::this_thread::sleep_for(20ms);
+    }
+    ASSERT_EQ(nb_heights_to_write(), 1);
+    messages::TaggedBlock tip;
+    ASSERT_TRUE(ledger->get_last_block(&tip));
+    ASSERT_EQ(tip.block().header().height(), 0);
+
+    consensus->stop_miner();
+    ASSERT_FALSE(consensus->_is_miner_running);
+    consensus->_miner_thread.join();
+    ASSERT_EQ(nb_heights_to_write(), 1);
+  }
 };
 
 TEST_F(Consensus, is_valid_transaction) { test_is_valid_transaction(); }
@@ -604,6 +728,14 @@ TEST_F(Consensus, add_transaction) {
 
 TEST_F(Consensus, build_block) { test_build_block(); }
 
+TEST_F(Consensus, prepare_block) { test_prepare_block(); }
+
+TEST_F(Consensus, block_template_interval) {
+  test_block_template_interval();
+}
+
+TEST_F(Consensus, verify_invalid_chain) { test_verify_invalid_chain(); }
+
 TEST_F(Consensus, add_denunciations) {
   // Let's make the first miner double mine
   auto block1 = simulator.new_block();
@@ -732,6 +864,8 @@ TEST_F(Consensus, check_block_author) { test_check_block_author(); }
 
 TEST_F(Consensus, check_integrity) { test_check_integrity(); }
 
+TEST_F(Consensus, miner_schedule) { test_miner_schedule(); }
+
 }  // namespace tests
 }  // namespace consensus
 }  // namespace neuro
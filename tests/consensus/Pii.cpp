@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
 
 #include "consensus/Pii.hpp"
 #include "ledger/LedgerMongodb.hpp"
@@ -538,6 +540,136 @@ class Pii : public testing::Test {
       ASSERT_TRUE(almost_eq(pii, 1));
     }
   }
+
+  void test_key_pubs_pii_integrities() {
+    messages::TaggedBlock last_block;
+    ASSERT_TRUE(ledger->get_last_block(&last_block));
+    const auto &branch_path = last_block.branch_path();
+
+    // Enough key pubs for the scores to be computed on several threads
+    const std::size_t nb_key_pubs = 4 * consensus::MIN_KEY_PUBS_PER_WORKER;
+    std::mt19937_64 random_engine(0);
+    std::vector<messages::_KeyPub> key_pubs(nb_key_pubs);
+    for (auto &key_pub : key_pubs) {
+      std::string raw_data(33, 2);
+      for (std::size_t j = 1; j < raw_data.size(); j++) {
+        raw_data[j] = static_cast<char>(random_engine());
+      }
+      key_pub.set_raw_data(raw_data);
+    }
+    for (std::size_t i = 0; i < nb_key_pubs; i++) {
+      for (std::size_t j = 1; j <= i % 4; j++) {
+        pii._key_pubs.add_enthalpy(key_pubs[(i + j) % nb_key_pubs],
+                                   key_pubs[i], 1 + i % 7);
+      }
+    }
+
+    // Some key pubs have an integrity, some of them changed at a later block
+    for (std::size_t i = 0; i < nb_key_pubs; i += 3) {
+      const std::size_t nb_integrities = 1 + i % 2;
+      for (std::size_t block_height = 0; block_height < nb_integrities;
+           block_height++) {
+        messages::Integrity integrity;
+        integrity.mutable_key_pub()->CopyFrom(key_pubs[i]);
+        integrity.mutable_assembly_id()->CopyFrom(
+            last_block.block().header().id());
+        integrity.set_assembly_height(0);
+        integrity.set_block_height(block_height);
+        integrity.set_score(std::to_string(i * 10 + block_height));
+        integrity.mutable_branch_path()->CopyFrom(branch_path);
+        ASSERT_TRUE(ledger->set_integrity(integrity));
+      }
+    }
+
+    // The scores of the per key_pub integrity lookups, in the same order
+    std::vector<messages::Pii> expected;
+    for (const auto &key_pub : pii._key_pubs.key_pubs()) {
+      auto &expected_pii = expected.emplace_back();
+      Double integrity_score = ledger->get_integrity(key_pub, 0, branch_path);
+      Double divided_integrity = integrity_score / 2400;
+      auto integrity = 1 + 0.1 * divided_integrity / (1 + divided_integrity);
+      auto score =
+          mpfr::fmax(1, integrity * pii._key_pubs.get_entropy(key_pub));
+      expected_pii.set_score(score.toString());
+      expected_pii.mutable_key_pub()->CopyFrom(key_pub);
+    }
+    std::sort(expected.begin(), expected.end(),
+              [](const messages::Pii &a, const messages::Pii &b) {
+                if (a.score() == b.score()) {
+                  return a.key_pub().raw_data() > b.key_pub().raw_data();
+                }
+                return a.score() > b.score();
+              });
+
+    const auto piis = pii.get_key_pubs_pii(1, branch_path);
+    ASSERT_EQ(piis.size(), nb_key_pubs);
+    ASSERT_EQ(piis.size(), expected.size());
+    for (std::size_t i = 0; i < piis.size(); i++) {
+      ASSERT_EQ(piis[i].key_pub(), expected[i].key_pub());
+      ASSERT_EQ(piis[i].score(), expected[i].score());
+    }
+  }
+
+  void test_benchmark_add_block() {
+    // A block sending to 10k keys, the time is spent in the maps keyed by
+    // key pub, which only used the first byte of the key as hash
+    const int nb_recipients = 10000;
+    std::mt19937_64 random_engine(0);
+    messages::Block block0;
+    ASSERT_TRUE(ledger->get_block(0, &block0));
+    messages::Block block;
+    auto header = block.mutable_header();
+    header->mutable_previous_block_hash()->CopyFrom(block0.header().id());
+    header->mutable_timestamp()->set_data(block0.header().timestamp().data() +
+                                          1);
+    header->set_height(1);
+    auto transaction = block.add_transactions();
+    for (int i = 0; i < nb_recipients; i++) {
+      std::string raw_data(33, static_cast<char>(2 + (random_engine() & 1)));
+      for (std::size_t j = 1; j < raw_data.size(); j++) {
+        raw_data[j] = static_cast<char>(random_engine());
+      }
+      auto output = transaction->add_outputs();
+      output->mutable_key_pub()->set_raw_data(raw_data);
+      output->mutable_value()->set_value(1);
+    }
+    auto input = transaction->add_inputs();
+    input->mutable_key_pub()->CopyFrom(simulator.key_pubs[0]);
+    input->mutable_value()->set_value(nb_recipients);
+    transaction->mutable_last_seen_block_id()->CopyFrom(block0.header().id());
+    auto reward = block.mutable_coinbase()->add_outputs();
+    reward->mutable_key_pub()->CopyFrom(simulator.key_pubs[0]);
+    reward->mutable_value()->set_value(nb_recipients);
+    block.mutable_coinbase()->mutable_last_seen_block_id()->CopyFrom(
+        block0.header().id());
+    messages::set_block_hash(&block);
+
+    // Pii::add_block reads the balances of the block from the ledger
+    ASSERT_TRUE(ledger->insert_block(block));
+    messages::TaggedBlock tagged_block;
+    ASSERT_TRUE(ledger->get_block(block.header().id(), &tagged_block));
+    auto start = Timer::now();
+    ASSERT_TRUE(ledger->add_balances(
+        &tagged_block, simulator.consensus->config().blocks_per_assembly));
+    const auto add_balances_duration = Timer::now() - start;
+    ASSERT_EQ(tagged_block.balances_size(), nb_recipients + 1);
+
+    start = Timer::now();
+    ASSERT_TRUE(pii.add_block(tagged_block));
+    const auto add_block_duration = Timer::now() - start;
+    ASSERT_EQ(pii._key_pubs._key_pubs.size(), nb_recipients + 1);
+
+    // Only logged, the durations depend on the machine and the database
+    LOG_INFO << nb_recipients << " keys add_balances "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(
+                    add_balances_duration)
+                    .count()
+             << "ms Pii add_block "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(
+                    add_block_duration)
+                    .count()
+             << "ms";
+  }
 };
 
 TEST(KeyPubs, get_pii) {
@@ -577,6 +709,10 @@ TEST_F(Pii, send_receive_pii) { test_send_receive_pii(); }
 
 TEST_F(Pii, previous_pii) { test_previous_pii(); }
 
+TEST_F(Pii, key_pubs_pii_integrities) { test_key_pubs_pii_integrities(); }
+
+TEST_F(Pii, benchmark_add_block) { test_benchmark_add_block(); }
+
 }  // namespace tests
 }  // namespace consensus
 }  // namespace neuro
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include "src/consensus/TransactionCache.hpp"
+
+namespace neuro {
+namespace consensus {
+namespace tests {
+
+messages::Transaction transaction(const std::string &id, uint64_t value) {
+  messages::Transaction transaction;
+  transaction.mutable_id()->set_data(id);
+  transaction.mutable_last_seen_block_id()->set_data("block");
+  auto output = transaction.add_outputs();
+  output->mutable_key_pub()->set_raw_data("key_pub");
+  output->mutable_value()->set_value(value);
+  return transaction;
+}
+
+TEST(TransactionCache, contains) {
+  TransactionCache cache(10);
+  const auto transaction0 = transaction("0", 1);
+  ASSERT_FALSE(cache.contains(transaction0));
+  cache.insert(transaction0);
+  ASSERT_TRUE(cache.contains(transaction0));
+  ASSERT_EQ(cache.size(), 1);
+  ASSERT_EQ(cache.hits(), 1);
+  ASSERT_EQ(cache.misses(), 1);
+  ASSERT_EQ(cache.hit_rate(), 0.5);
+
+  // Same id but a different content should not be trusted
+  ASSERT_FALSE(cache.contains(transaction("0", 2)));
+}
+
+TEST(TransactionCache, bounded) {
+  TransactionCache cache(2);
+  cache.insert(transaction("0", 1));
+  cache.insert(transaction("1", 1));
+
+  // Touch 0 so that 1 is the least recently used
+  ASSERT_TRUE(cache.contains(transaction("0", 1)));
+  cache.insert(transaction("2", 1));
+  ASSERT_EQ(cache.size(), 2);
+  ASSERT_TRUE(cache.contains(transaction("0", 1)));
+  ASSERT_FALSE(cache.contains(transaction("1", 1)));
+  ASSERT_TRUE(cache.contains(transaction("2", 1)));
+
+  TransactionCache disabled(0);
+  disabled.insert(transaction("0", 1));
+  ASSERT_EQ(disabled.size(), 0);
+}
+
+}  // namespace tests
+}  // namespace consensus
+}  // namespace neuro
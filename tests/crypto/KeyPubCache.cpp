@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "common/logger.hpp"
+#include "crypto/Ecc.hpp"
+#include "crypto/KeyPubCache.hpp"
+
+namespace neuro {
+namespace crypto {
+namespace tests {
+
+TEST(KeyPubCache, get) {
+  KeyPubCache cache;
+  Ecc ecc;
+  messages::_KeyPub key_pub;
+  ecc.key_pub().save(&key_pub);
+
+  // A key used once is not worth its precomputed tables
+  const auto first_key_pub = cache.get(key_pub);
+  ASSERT_EQ(cache.misses(), 1);
+  ASSERT_EQ(cache.hits(), 0);
+  ASSERT_FALSE(first_key_pub->is_precomputed());
+
+  // It is precomputed the second time it is used
+  const auto cached_key_pub = cache.get(key_pub);
+  ASSERT_TRUE(cached_key_pub->is_precomputed());
+  ASSERT_EQ(cache.get(key_pub), cached_key_pub);
+  ASSERT_EQ(cache.misses(), 1);
+  ASSERT_EQ(cache.hits(), 2);
+  ASSERT_EQ(*cached_key_pub, ecc.key_pub());
+  ASSERT_EQ(*first_key_pub, ecc.key_pub());
+
+  // The hex form is another entry of the same key
+  messages::_KeyPub hex_key_pub;
+  ecc.key_pub().save_as_hex(&hex_key_pub);
+  ASSERT_EQ(*cache.get(hex_key_pub), ecc.key_pub());
+  ASSERT_EQ(cache.misses(), 2);
+  ASSERT_EQ(cache.size(), 2);
+
+  // The keys known to be reused are precomputed at once
+  Ecc peer_ecc;
+  messages::_KeyPub peer_key_pub;
+  peer_ecc.key_pub().save(&peer_key_pub);
+  ASSERT_TRUE(cache.get(peer_key_pub, true)->is_precomputed());
+}
+
+TEST(KeyPubCache, eviction) {
+  KeyPubCache cache(KeyPubCache::NB_SHARDS);
+  std::vector<messages::_KeyPub> key_pubs(4 * KeyPubCache::NB_SHARDS);
+  for (auto &key_pub : key_pubs) {
+    Ecc().key_pub().save(&key_pub);
+    cache.get(key_pub);
+  }
+  // Every shard keeps a single key
+  ASSERT_LE(cache.size(), KeyPubCache::NB_SHARDS);
+  ASSERT_EQ(cache.misses(), key_pubs.size());
+
+  // The last key is the most recent of its shard
+  cache.get(key_pubs.back());
+  ASSERT_EQ(cache.hits(), 1);
+}
+
+TEST(KeyPubCache, verify) {
+  KeyPubCache cache;
+  Ecc ecc;
+  messages::_KeyPub key_pub;
+  ecc.key_pub().save(&key_pub);
+  const Buffer data("some data to sign");
+  const auto signature = ecc.key_priv().sign(data);
+  auto wrong_signature = signature;
+  wrong_signature[0] += 1;
+
+  const KeyPub uncached_key_pub(key_pub);
+  const auto cached_key_pub = cache.get(key_pub, true);
+  ASSERT_TRUE(uncached_key_pub.verify(data, signature));
+  ASSERT_TRUE(cached_key_pub->verify(data, signature));
+  ASSERT_FALSE(uncached_key_pub.verify(data, wrong_signature));
+  ASSERT_FALSE(cached_key_pub->verify(data, wrong_signature));
+
+  const int nb_verifications = 200;
+  const auto start_uncached = Timer::now();
+  for (int i = 0; i < nb_verifications; i++) {
+    KeyPub(key_pub).verify(data, signature);
+  }
+  const auto start_cached = Timer::now();
+  for (int i = 0; i < nb_verifications; i++) {
+    cache.get(key_pub)->verify(data, signature);
+  }
+  const auto end = Timer::now();
+  LOG_INFO << "Verifications per second without cache "
+           << nb_verifications /
+                  std::chrono::duration<double>(start_cached - start_uncached)
+                      .count()
+           << " with cache "
+           << nb_verifications /
+                  std::chrono::duration<double>(end - start_cached).count();
+}
+
+}  // namespace tests
+}  // namespace crypto
+}  // namespace neuro
@@ -81,7 +81,7 @@ class BotTest : public Bot {
     std::sort(ports.begin(), ports.end());
     std::vector<int> peers_ports;
     for (const auto &peer : connected_peers()) {
-      peers_ports.push_back(peer->port() - _port_offset);
+      peers_ports.push_back(peer.port() - _port_offset);
     }
     std::sort(peers_ports.begin(), peers_ports.end());
     EXPECT_EQ(ports, peers_ports);
@@ -103,15 +103,15 @@ class BotTest : public Bot {
 
   bool check_is_connected(std::vector<Port> ports) {
     for (auto port : ports) {
-      std::optional<neuro::messages::Peer *> found_peer;
+      bool found_peer = false;
       for (const auto &peer : connected_peers()) {
-        if (peer->port() == port + _port_offset) {
-          found_peer = peer;
+        if (peer.port() == port + _port_offset) {
+          found_peer = true;
           break;
         }
       }
-      EXPECT_TRUE(found_peer.has_value());
-      if (!found_peer.has_value()) {
+      EXPECT_TRUE(found_peer);
+      if (!found_peer) {
         return false;
       }
     }
@@ -128,7 +128,7 @@ class BotTest : public Bot {
       std::sort(ports.begin(), ports.end());
       std::vector<Port> peers_ports;
       for (const auto &peer : connected_peers()) {
-        peers_ports.push_back(peer->port() - _port_offset);
+        peers_ports.push_back(peer.port() - _port_offset);
       }
       std::sort(peers_ports.begin(), peers_ports.end());
       has_ports = peers_ports == ports;
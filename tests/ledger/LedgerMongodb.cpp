@@ -109,6 +109,62 @@ class LedgerMongodb : public ::testing::Test {
     ASSERT_TRUE(ledger->is_ancestor(fork1, fork1));
   }
 
+  void test_tip_candidates() {
+    messages::Block block0, block1, fork1, fork2;
+    ASSERT_TRUE(ledger->get_block(0, &block0));
+    tooling::blockgen::blockgen_from_block(&block1, block0, 1);
+    // Use a different height so that the fork has a different id
+    tooling::blockgen::blockgen_from_block(&fork1, block0, 2);
+    tooling::blockgen::blockgen_from_block(&fork2, fork1, 3);
+    for (const auto *block : {&block1, &fork1, &fork2}) {
+      ASSERT_TRUE(ledger->insert_block(*block));
+    }
+    const auto &assembly_id = block0.header().id();
+
+    // Verifying a block again with the same score does not modify it
+    ASSERT_TRUE(ledger->set_block_verified(block1.header().id(), 20,
+                                           assembly_id));
+    ASSERT_FALSE(ledger->set_block_verified(block1.header().id(), 20,
+                                            assembly_id));
+
+    // On equal scores the block verified first stays the tip
+    ASSERT_TRUE(ledger->set_block_verified(fork1.header().id(), 20,
+                                           assembly_id));
+    ASSERT_TRUE(ledger->update_main_branch());
+    ASSERT_EQ(ledger->get_main_branch_tip().block().header().id(),
+              block1.header().id());
+
+    // A better fork becomes the tip and its parent is not a candidate anymore
+    ASSERT_TRUE(ledger->set_block_verified(fork2.header().id(), 25,
+                                           assembly_id));
+    ASSERT_EQ(ledger->_tip_candidates_keys.count(fork1.header().id().data()),
+              0);
+    ASSERT_TRUE(ledger->update_main_branch());
+    ASSERT_EQ(ledger->get_main_branch_tip().block().header().id(),
+              fork2.header().id());
+
+    // A ledger restarted on the same database loads the best tip lazily
+    {
+      ::neuro::ledger::LedgerMongodb restarted(db_url, db_name);
+      ASSERT_FALSE(restarted._is_tip_candidates_loaded);
+      ASSERT_TRUE(restarted.update_main_branch());
+      ASSERT_TRUE(restarted._is_tip_candidates_loaded);
+      messages::BlockID best_id;
+      ASSERT_TRUE(restarted.get_best_tip_candidate(&best_id));
+      ASSERT_EQ(best_id, fork2.header().id());
+    }
+
+    // An invalid fork cannot be the tip, even once reloaded
+    ASSERT_TRUE(ledger->set_branch_invalid(fork1.header().id()));
+    ASSERT_FALSE(ledger->_is_tip_candidates_loaded);
+    ASSERT_TRUE(ledger->update_main_branch());
+    ASSERT_EQ(ledger->get_main_branch_tip().block().header().id(),
+              block1.header().id());
+    messages::TaggedBlock tagged_block;
+    ASSERT_TRUE(ledger->get_block(block1.header().id(), &tagged_block));
+    ASSERT_EQ(tagged_block.branch(), messages::Branch::MAIN);
+  }
+
   void test_update_main_branch() {
     messages::Block block0, block1, block2, fork1, fork2, fork3;
     ASSERT_TRUE(ledger->get_block(0, &block0));
@@ -466,6 +522,8 @@ TEST_F(LedgerMongodb, get_unverified_blocks) {
 
 TEST_F(LedgerMongodb, update_main_branch) { test_update_main_branch(); }
 
+TEST_F(LedgerMongodb, tip_candidates) { test_tip_candidates(); }
+
 TEST_F(LedgerMongodb, is_ancestor) { test_is_ancestor(); }
 
 TEST_F(LedgerMongodb, empty_database) {
@@ -593,6 +651,39 @@ TEST_F(LedgerMongodb, integrity) {
   ASSERT_EQ(integrity_score, 17);
 }
 
+TEST_F(LedgerMongodb, integrities) {
+  messages::TaggedBlock block0;
+  ASSERT_TRUE(ledger->get_last_block(&block0));
+  std::vector<crypto::Ecc> eccs(3);
+  std::vector<messages::_KeyPub> key_pubs;
+  for (int i = 0; i < 2; i++) {
+    messages::Integrity integrity;
+    integrity.mutable_key_pub()->CopyFrom(eccs[i].key_pub());
+    integrity.mutable_assembly_id()->CopyFrom(block0.block().header().id());
+    integrity.set_assembly_height(0);
+    integrity.set_block_height(0);
+    integrity.set_score(std::to_string(10 + i));
+    integrity.mutable_branch_path()->CopyFrom(block0.branch_path());
+    ASSERT_TRUE(ledger->set_integrity(integrity));
+  }
+  for (const auto &ecc : eccs) {
+    key_pubs.push_back(ecc.key_pub());
+  }
+
+  // The third key_pub has no integrity
+  auto scores = ledger->get_integrities(key_pubs, 0, block0.branch_path());
+  ASSERT_EQ(scores.size(), key_pubs.size());
+  for (std::size_t i = 0; i < key_pubs.size(); i++) {
+    ASSERT_EQ(scores[i],
+              ledger->get_integrity(key_pubs[i], 0, block0.branch_path()));
+  }
+  ASSERT_EQ(scores[0], 10);
+  ASSERT_EQ(scores[1], 11);
+  ASSERT_EQ(scores[2], 0);
+
+  ASSERT_TRUE(ledger->get_integrities({}, 0, block0.branch_path()).empty());
+}
+
 TEST_F(LedgerMongodb, set_previous_assembly_id) {
   messages::TaggedBlock tagged_block;
   ASSERT_TRUE(ledger->get_block(0, &tagged_block));
@@ -843,6 +934,33 @@ TEST_F(LedgerMongodb, get_blocks) {
               blocks.at(1).block() == block1_bis);
 }
 
+TEST_F(LedgerMongodb, get_blocks_by_ids) {
+  messages::TaggedBlock block0;
+  ASSERT_TRUE(ledger->get_block(0, &block0, false));
+  auto block1 = simulator.new_block();
+  ASSERT_TRUE(simulator.consensus->add_block(block1));
+  messages::BlockID unknown_id;
+  unknown_id.set_data("unknown");
+
+  std::vector<messages::TaggedBlock> tagged_blocks;
+  ASSERT_FALSE(ledger->get_blocks_by_ids({}, &tagged_blocks));
+  ASSERT_FALSE(ledger->get_blocks_by_ids({unknown_id}, &tagged_blocks));
+  ASSERT_TRUE(tagged_blocks.empty());
+
+  // Duplicated and unknown ids are skipped
+  const auto &block0_id = block0.block().header().id();
+  ASSERT_TRUE(ledger->get_blocks_by_ids(
+      {block0_id, block1.header().id(), block0_id, unknown_id},
+      &tagged_blocks, false));
+  ASSERT_EQ(tagged_blocks.size(), 2);
+  for (const auto &tagged_block : tagged_blocks) {
+    messages::TaggedBlock expected;
+    ASSERT_TRUE(ledger->get_block(tagged_block.block().header().id(),
+                                  &expected, false));
+    ASSERT_EQ(tagged_block, expected);
+  }
+}
+
 TEST_F(LedgerMongodb, double_minings) {
   // Let's make the first miner double mine
   auto block1 = simulator.new_block();
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <unordered_set>
+
+#include "messages/Hasher.hpp"
+#include "messages/Message.hpp"
+
+namespace neuro {
+namespace messages {
+namespace test {
+
+TEST(Message, equal_hash) {
+  const auto hash = Hasher::random();
+  Hash copy;
+  copy.CopyFrom(hash);
+  ASSERT_EQ(hash, copy);
+  ASSERT_EQ(std::hash<Hash>()(hash), std::hash<Hash>()(copy));
+  ASSERT_NE(hash, Hasher::random());
+  ASSERT_NE(hash, Hash());
+
+  std::unordered_set<Hash> hashes{hash};
+  ASSERT_EQ(hashes.count(copy), 1);
+  ASSERT_EQ(hashes.count(Hasher::random()), 0);
+}
+
+TEST(Message, equal_key_pub) {
+  _KeyPub raw, other_raw, hex;
+  raw.set_raw_data(std::string(33, 2));
+  other_raw.set_raw_data(std::string(32, 2) + std::string(1, 3));
+  hex.set_hex_data(raw.raw_data());
+  ASSERT_EQ(raw, _KeyPub(raw));
+  ASSERT_NE(raw, other_raw);
+  ASSERT_NE(std::hash<_KeyPub>()(raw), std::hash<_KeyPub>()(other_raw));
+  // The raw and hex forms are different packets
+  ASSERT_NE(raw, hex);
+}
+
+TEST(Message, equal_packet) {
+  Transaction transaction;
+  transaction.mutable_id()->CopyFrom(Hasher::random());
+  transaction.mutable_last_seen_block_id()->CopyFrom(Hasher::random());
+  auto output = transaction.add_outputs();
+  output->mutable_key_pub()->set_raw_data(std::string(33, 2));
+  output->mutable_value()->set_value(10);
+  Transaction copy;
+  copy.CopyFrom(transaction);
+  ASSERT_EQ(transaction, copy);
+  ASSERT_EQ(PacketHash<Transaction>()(transaction),
+            PacketHash<Transaction>()(copy));
+
+  // A field set to its default value is not the same as an unset field
+  copy.set_expires(0);
+  ASSERT_NE(transaction, copy);
+  copy.clear_expires();
+  copy.mutable_outputs(0)->mutable_value()->set_value(11);
+  ASSERT_NE(transaction, copy);
+}
+
+TEST(Message, unknown_fields) {
+  Transaction transaction;
+  transaction.mutable_id()->CopyFrom(Hasher::random());
+  auto output = transaction.add_outputs();
+  output->mutable_key_pub()->set_raw_data(std::string(33, 2));
+  output->mutable_value()->set_value(10);
+  Transaction copy;
+  copy.CopyFrom(transaction);
+
+  // A field from a later version of the packet is ignored, even nested
+  copy.GetReflection()->MutableUnknownFields(&copy)->AddVarint(1000, 1);
+  auto copy_output = copy.mutable_outputs(0);
+  copy_output->GetReflection()
+      ->MutableUnknownFields(copy_output)
+      ->AddVarint(1000, 2);
+  ASSERT_EQ(transaction, copy);
+  ASSERT_EQ(copy, transaction);
+  ASSERT_EQ(PacketHash<Transaction>()(transaction),
+            PacketHash<Transaction>()(copy));
+  ASSERT_EQ(copy.outputs(0)
+                .GetReflection()
+                ->GetUnknownFields(copy.outputs(0))
+                .field_count(),
+            1);
+
+  copy_output->mutable_value()->set_value(11);
+  ASSERT_NE(transaction, copy);
+}
+
+}  // namespace test
+}  // namespace messages
+}  // namespace neuro
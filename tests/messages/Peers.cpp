@@ -74,6 +74,13 @@ TEST_F(PeersF, pick) {
 
   const auto disconnected_peers = peers.by_status(Peer::DISCONNECTED);
   ASSERT_EQ(disconnected_peers.size(), 1);
+
+  peers.set_status(*new_peer2, Peer::CONNECTED);
+  const auto connected_peers = peers.connected_peers_copy();
+  ASSERT_EQ(connected_peers.size(), 2);
+  for (const auto &peer : connected_peers) {
+    ASSERT_EQ(peer.status(), Peer::CONNECTED);
+  }
 }
 
 TEST_F(PeersF, update_unreachable) {
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
 #include <typeinfo>
 
 #include "messages.pb.h"
@@ -23,7 +26,7 @@ class QueueTest {
  public:
   void test_empty() {
     auto tested_queue = messages::Queue{};
-    ASSERT_TRUE(tested_queue._queue.empty());
+    ASSERT_EQ(tested_queue.size(), 0);
     ASSERT_TRUE(tested_queue.is_empty());
   }
 
@@ -55,7 +58,7 @@ class QueueTest {
   void test_pushing_message() {
     auto tested_queue = messages::Queue{};
     tested_queue.push(std::make_shared<const messages::Message>());
-    ASSERT_FALSE(tested_queue._queue.empty());
+    ASSERT_FALSE(tested_queue.is_empty());
   };
 
   void test_message_broadcasting() {
@@ -134,6 +137,261 @@ class QueueTest {
     tested_queue.unsubscribe(&sub_world);
     ASSERT_EQ(count_world, 0);
   }
+
+  static std::shared_ptr<messages::Message> message(
+      messages::Type type, std::optional<uint32_t> connection_id = {}) {
+    auto message = std::make_shared<messages::Message>();
+    messages::fill_header(message->mutable_header());
+    if (connection_id) {
+      message->mutable_header()->set_connection_id(*connection_id);
+    }
+    auto body = message->add_bodies();
+    switch (type) {
+      case messages::Type::kHello:
+        body->mutable_hello();
+        break;
+      case messages::Type::kBlock:
+        body->mutable_block();
+        break;
+      default:
+        body->mutable_transaction();
+    }
+    return message;
+  }
+
+  void test_lanes() {
+    auto tested_queue = messages::Queue{};
+    ASSERT_TRUE(tested_queue.push(message(messages::Type::kTransaction)));
+    ASSERT_TRUE(tested_queue.push(message(messages::Type::kBlock)));
+    ASSERT_TRUE(tested_queue.push(message(messages::Type::kHello)));
+    ASSERT_TRUE(tested_queue.push(message(messages::Type::kTransaction)));
+
+    const auto lanes_status = tested_queue.lanes_status();
+    ASSERT_EQ(lanes_status.size(), 3);
+    ASSERT_EQ(lanes_status[messages::Queue::CONTROL].depth, 1);
+    ASSERT_EQ(lanes_status[messages::Queue::BLOCKS].depth, 1);
+    ASSERT_EQ(lanes_status[messages::Queue::TRANSACTIONS].depth, 2);
+
+    // The control messages are served first, then the blocks
+    const std::vector<messages::Type> expected_types{
+        messages::Type::kHello, messages::Type::kBlock,
+        messages::Type::kTransaction, messages::Type::kTransaction};
+    for (const auto expected_type : expected_types) {
+      const auto next = tested_queue.next_message();
+      ASSERT_NE(next, nullptr);
+      ASSERT_EQ(messages::get_type(next->bodies(0)), expected_type);
+    }
+    ASSERT_EQ(tested_queue.next_message(), nullptr);
+    ASSERT_TRUE(tested_queue.is_empty());
+    for (const auto &lane_status : tested_queue.lanes_status()) {
+      ASSERT_EQ(lane_status.depth, 0);
+      ASSERT_GE(lane_status.max_wait.count(), 0);
+    }
+    ASSERT_EQ(tested_queue.lanes_status()[messages::Queue::TRANSACTIONS].popped,
+              2);
+  }
+
+  void test_pending_push() {
+    auto tested_queue = messages::Queue{};
+    std::atomic<int> nb_handled{0};
+    messages::Subscriber subscriber(&tested_queue);
+    subscriber.subscribe(
+        messages::Type::kTransaction,
+        [&nb_handled](const messages::Header &, const messages::Body &) {
+          nb_handled++;
+        });
+
+    // A push counted in its lane whose entry cannot be popped yet
+    auto &lane = *tested_queue._lanes[messages::Queue::TRANSACTIONS];
+    lane.depth++;
+    bool is_push_pending = false;
+    ASSERT_EQ(tested_queue.next_message(nullptr, &is_push_pending), nullptr);
+    ASSERT_TRUE(is_push_pending);
+    ASSERT_FALSE(lane.is_busy);
+
+    // The worker waits for the end of the push instead of spinning, which
+    // would use the whole sleep of cpu time
+    tested_queue.run();
+    const auto start = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ASSERT_LT(std::clock() - start, CLOCKS_PER_SEC / 20);
+
+    lane.depth--;
+    ASSERT_TRUE(tested_queue.push(message(messages::Type::kTransaction)));
+    for (int i = 0; i < 1000 && nb_handled == 0; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(nb_handled, 1);
+  }
+
+  void test_backpressure() {
+    auto tested_queue = messages::Queue{};
+    tested_queue.set_limits(8, 4);
+    bool is_resumed = false;
+    const auto resume = [&is_resumed]() { is_resumed = true; };
+
+    // A peer is paused once it has max_per_source messages queued
+    for (int i = 0; i < 3; i++) {
+      tested_queue.push(message(messages::Type::kTransaction, 1));
+      ASSERT_FALSE(tested_queue.pause(1, resume));
+    }
+    tested_queue.push(message(messages::Type::kTransaction, 1));
+    ASSERT_TRUE(tested_queue.pause(1, resume));
+    ASSERT_FALSE(tested_queue.pause(2, resume));
+
+    // and resumed once half of them are handled
+    tested_queue.next_message();
+    ASSERT_FALSE(is_resumed);
+    tested_queue.next_message();
+    ASSERT_TRUE(is_resumed);
+
+    // When the queue is full, the peers with queued messages are paused but
+    // the others can still push
+    for (int i = 0; i < 3; i++) {
+      tested_queue.push(message(messages::Type::kBlock, 2));
+      tested_queue.push(message(messages::Type::kBlock, 3));
+    }
+    ASSERT_EQ(tested_queue.size(), 8);
+    ASSERT_TRUE(tested_queue.pause(2, resume));
+    ASSERT_FALSE(tested_queue.pause(4, resume));
+  }
+
+  /**
+   * \brief Handle as many inventories as get_blocks, each taking some time
+   * \return number of messages handled per second
+   */
+  double benchmark(std::size_t nb_workers) {
+    const std::size_t nb_messages_per_lane = 1000;
+    const auto handling_time = std::chrono::microseconds(100);
+    auto tested_queue = messages::Queue{};
+    tested_queue.set_workers(nb_workers);
+    messages::Subscriber subscriber(&tested_queue);
+    std::mutex mutex;
+    std::vector<int32_t> inventories;
+    std::vector<int32_t> get_blocks;
+    subscriber.subscribe(
+        messages::Type::kInventory,
+        [&](const messages::Header &header, const messages::Body &) {
+          std::this_thread::sleep_for(handling_time);
+          std::lock_guard lock(mutex);
+          inventories.push_back(header.request_id());
+        });
+    subscriber.subscribe(
+        messages::Type::kGetBlock,
+        [&](const messages::Header &header, const messages::Body &) {
+          std::this_thread::sleep_for(handling_time);
+          std::lock_guard lock(mutex);
+          get_blocks.push_back(header.request_id());
+        });
+
+    for (std::size_t i = 0; i < nb_messages_per_lane; i++) {
+      auto inventory = std::make_shared<messages::Message>();
+      messages::fill_header(inventory->mutable_header());
+      inventory->mutable_header()->set_request_id(i);
+      inventory->add_bodies()->mutable_inventory();
+      tested_queue.push(inventory);
+      auto get_block = std::make_shared<messages::Message>();
+      messages::fill_header(get_block->mutable_header());
+      get_block->mutable_header()->set_request_id(i);
+      get_block->add_bodies()->mutable_get_block();
+      tested_queue.push(get_block);
+    }
+
+    const auto start = Timer::now();
+    tested_queue.run();
+    while (true) {
+      {
+        std::lock_guard lock(mutex);
+        if (inventories.size() + get_blocks.size() ==
+            2 * nb_messages_per_lane) {
+          break;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    const std::chrono::duration<double> elapsed = Timer::now() - start;
+    tested_queue.quit();
+
+    // The messages of a lane are handled in order whatever the number of
+    // workers
+    EXPECT_TRUE(std::is_sorted(inventories.begin(), inventories.end()));
+    EXPECT_TRUE(std::is_sorted(get_blocks.begin(), get_blocks.end()));
+
+    const auto throughput = 2 * nb_messages_per_lane / elapsed.count();
+    LOG_INFO << nb_workers << " workers handled " << throughput
+             << " messages/s";
+    return throughput;
+  }
+
+  /**
+   * \brief Time from push() to the handler with messages pushed concurrently,
+   * like the tcp io threads and the miner do
+   */
+  void test_latency() {
+    const std::size_t nb_producers = 2;
+    const std::size_t messages_per_producer = 2000;
+    const std::size_t nb_messages = nb_producers * messages_per_producer;
+    auto tested_queue = messages::Queue{};
+    tested_queue.set_workers(3);
+    messages::Subscriber subscriber(&tested_queue);
+    std::vector<Timer::time_point> push_times(nb_messages);
+    std::mutex mutex;
+    std::vector<Timer::duration> latencies;
+    subscriber.subscribe(
+        messages::Type::kInventory,
+        [&](const messages::Header &header, const messages::Body &) {
+          const auto latency = Timer::now() - push_times[header.request_id()];
+          std::lock_guard lock(mutex);
+          latencies.push_back(latency);
+        });
+    tested_queue.run();
+
+    std::vector<std::thread> producers;
+    for (std::size_t producer = 0; producer < nb_producers; producer++) {
+      producers.emplace_back([&, producer]() {
+        for (std::size_t i = 0; i < messages_per_producer; i++) {
+          const auto index = producer * messages_per_producer + i;
+          auto message = std::make_shared<messages::Message>();
+          messages::fill_header(message->mutable_header());
+          message->mutable_header()->set_request_id(index);
+          message->add_bodies()->mutable_inventory();
+          push_times[index] = Timer::now();
+          tested_queue.push(message);
+          // Leave the workers idle between the messages
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+      });
+    }
+    for (auto &producer : producers) {
+      producer.join();
+    }
+    while (true) {
+      {
+        std::lock_guard lock(mutex);
+        if (latencies.size() == nb_messages) {
+          break;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    tested_queue.quit();
+
+    std::sort(latencies.begin(), latencies.end());
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    const Microseconds p50 = latencies[nb_messages / 2];
+    const Microseconds p99 = latencies[nb_messages * 99 / 100];
+    LOG_INFO << "push to handler latency p50 " << p50.count() << "us p99 "
+             << p99.count() << "us";
+    // A lost wake up would wait for a timeout
+    ASSERT_LT(p99, std::chrono::milliseconds(100));
+  }
+
+  void test_workers() {
+    const auto sequential = benchmark(1);
+    const auto parallel = benchmark(3);
+    // The inventories and the get_blocks are handled in parallel
+    ASSERT_GT(parallel, 1.5 * sequential);
+  }
 };
 
 TEST(Queue, empty) {
@@ -156,6 +414,31 @@ TEST(Queue, message_broadcasting) {
   mqt.test_message_broadcasting();
 }
 
+TEST(Queue, lanes) {
+  QueueTest mqt;
+  mqt.test_lanes();
+}
+
+TEST(Queue, pending_push) {
+  QueueTest mqt;
+  mqt.test_pending_push();
+}
+
+TEST(Queue, backpressure) {
+  QueueTest mqt;
+  mqt.test_backpressure();
+}
+
+TEST(Queue, workers) {
+  QueueTest mqt;
+  mqt.test_workers();
+}
+
+TEST(Queue, latency) {
+  QueueTest mqt;
+  mqt.test_latency();
+}
+
 }  // namespace test
 }  // namespace messages
 }  // namespace neuro
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include "messages/Message.hpp"
+#include "messages/RecentBodies.hpp"
+
+namespace neuro {
+namespace messages {
+namespace test {
+
+namespace {
+
+Body transaction_body(int i) {
+  Body body;
+  body.mutable_transaction()->mutable_id()->set_data("transaction" +
+                                                     std::to_string(i));
+  return body;
+}
+
+RecentBodies::Key transaction_key(int i) {
+  return RecentBodies::key(transaction_body(i));
+}
+
+}  // namespace
+
+TEST(RecentBodies, body) {
+  messages::RecentBodies recent_bodies;
+  auto body = transaction_body(0);
+  ASSERT_FALSE(recent_bodies.contains(RecentBodies::key(body), 0));
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(body), 0));
+  ASSERT_TRUE(recent_bodies.contains(RecentBodies::key(body), 0));
+  ASSERT_FALSE(recent_bodies.insert(RecentBodies::key(body), 1));
+
+  // A block and its compact block are different bodies
+  Body block;
+  block.mutable_block()->mutable_header()->mutable_id()->set_data("block");
+  Body compact_block;
+  compact_block.mutable_compact_block()
+      ->mutable_header()
+      ->mutable_id()
+      ->set_data("block");
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(block), 1));
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(compact_block), 1));
+  ASSERT_FALSE(recent_bodies.insert(RecentBodies::key(compact_block), 1));
+
+  Body world;
+  world.mutable_world()->set_accepted(true);
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(world), 1));
+  ASSERT_FALSE(recent_bodies.insert(RecentBodies::key(world), 1));
+  world.mutable_world()->set_accepted(false);
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(world), 1));
+}
+
+TEST(RecentBodies, forged_id) {
+  messages::RecentBodies recent_bodies;
+  const auto body = transaction_body(0);
+
+  // A body that claims the id of another one does not hide it
+  auto forged_body = body;
+  forged_body.mutable_transaction()->set_expires(10);
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(forged_body), 0));
+  ASSERT_FALSE(recent_bodies.contains(RecentBodies::key(body), 0));
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(body), 0));
+  ASSERT_FALSE(recent_bodies.insert(RecentBodies::key(body), 0));
+
+  Body forged_block;
+  forged_block.mutable_block()->mutable_header()->mutable_id()->set_data(
+      "block");
+  auto block = forged_block;
+  block.mutable_block()->mutable_header()->set_height(1);
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(forged_block), 0));
+  ASSERT_TRUE(recent_bodies.insert(RecentBodies::key(block), 0));
+}
+
+TEST(RecentBodies, keys) {
+  Message message;
+  message.add_bodies()->CopyFrom(transaction_body(0));
+  message.add_bodies()->mutable_world()->set_accepted(true);
+  message.add_bodies()->CopyFrom(transaction_body(1));
+  // The bodies miss required fields as the ones of a peer can
+  const auto bytes = message.SerializePartialAsString();
+  const Buffer buffer(bytes.data(), bytes.size());
+
+  // The keys hashed from the bytes match the keys of the parsed bodies
+  const auto body_keys = RecentBodies::keys(buffer);
+  ASSERT_EQ(body_keys.size(), 3u);
+  Message received;
+  ASSERT_TRUE(received.ParsePartialFromString(bytes));
+  received.set_body_keys(body_keys);
+  for (int i = 0; i < received.bodies_size(); i++) {
+    ASSERT_EQ(body_keys[i], RecentBodies::key(received.bodies(i)));
+    ASSERT_EQ(RecentBodies::key(received, i), body_keys[i]);
+  }
+  ASSERT_NE(body_keys[0], body_keys[2]);
+
+  // The keys that do not match the bodies are not used
+  received.add_bodies()->CopyFrom(transaction_body(2));
+  ASSERT_EQ(RecentBodies::key(received, 3), transaction_key(2));
+  ASSERT_EQ(RecentBodies::key(received, 0), transaction_key(0));
+
+  const Buffer truncated(bytes.data(), bytes.size() - 1);
+  ASSERT_TRUE(RecentBodies::keys(truncated).empty());
+}
+
+TEST(RecentBodies, expiry) {
+  const std::time_t ttl = 60;
+  const std::time_t start = 1000;
+  const int nb_bodies = 100;
+  messages::RecentBodies recent_bodies(ttl, 1024);
+
+  // All the bodies of the same second are kept ttl seconds and then expire
+  for (int i = 0; i < nb_bodies; i++) {
+    ASSERT_TRUE(recent_bodies.insert(transaction_key(i), start));
+  }
+  for (std::time_t t = start; t <= start + ttl; t++) {
+    for (int i = 0; i < nb_bodies; i++) {
+      ASSERT_TRUE(recent_bodies.contains(transaction_key(i), t));
+    }
+  }
+  // Inserting bodies later reuses the buckets of the expired ones
+  for (std::time_t t = start; t <= start + 3 * ttl; t++) {
+    recent_bodies.insert(transaction_key(nb_bodies + t), t);
+  }
+  for (int i = 0; i < nb_bodies; i++) {
+    ASSERT_FALSE(recent_bodies.contains(transaction_key(i), start + 3 * ttl));
+    ASSERT_TRUE(recent_bodies.insert(transaction_key(i), start + 3 * ttl));
+  }
+}
+
+TEST(RecentBodies, full) {
+  const std::size_t capacity = 16;
+  messages::RecentBodies recent_bodies(60, capacity);
+
+  // The bodies over the capacity are not remembered instead of using memory
+  int i = 0;
+  for (; i < 100; i++) {
+    ASSERT_TRUE(recent_bodies.insert(transaction_key(i), 0));
+  }
+  int nb_kept = 0;
+  for (i = 0; i < 100; i++) {
+    nb_kept += recent_bodies.contains(transaction_key(i), 0);
+  }
+  ASSERT_EQ(static_cast<std::size_t>(nb_kept), capacity - capacity / 4);
+  ASSERT_THROW(messages::RecentBodies(60, 100), std::runtime_error);
+}
+
+}  // namespace test
+}  // namespace messages
+}  // namespace neuro
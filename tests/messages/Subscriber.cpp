@@ -31,11 +31,13 @@ TEST(Subscriber, is_new_body) {
   messages::Subscriber tested_sub(&queue);
   auto message = getWorldMessage();
   for (const auto &body : message->bodies()) {
-    ASSERT_TRUE(tested_sub.is_new_body(std::time_t(nullptr), body));
+    ASSERT_TRUE(tested_sub.is_new_body(std::time_t(nullptr),
+                                       messages::RecentBodies::key(body)));
   }
   tested_sub.handler(message);
   for (const auto &body : message->bodies()) {
-    ASSERT_FALSE(tested_sub.is_new_body(std::time_t(nullptr), body));
+    ASSERT_FALSE(tested_sub.is_new_body(std::time_t(nullptr),
+                                        messages::RecentBodies::key(body)));
   }
   tested_sub.handler(message);
 }
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include "messages/Hasher.hpp"
+#include "networking/BlockSync.hpp"
+
+namespace neuro {
+namespace networking {
+namespace test {
+
+class BlockSync : public ::testing::Test {
+ protected:
+  using PeerID = networking::BlockSync::PeerID;
+  const std::vector<PeerID> _peer_ids{1, 2};
+  std::vector<messages::Block> _chain;
+  std::vector<std::pair<messages::Message, PeerID>> _requests;
+  std::vector<messages::BlockHeight> _added_heights;
+  networking::BlockSync _block_sync;
+
+  BlockSync()
+      : _block_sync(
+            [this](const messages::Message &message, PeerID peer) {
+              _requests.emplace_back(message, peer);
+              return true;
+            },
+            [this](const messages::Block &block) {
+              _added_heights.push_back(block.header().height());
+              return true;
+            },
+            [](const messages::BlockID &) { return false; }) {
+    // The tip of the ledger is at height 0
+    for (int i = 0; i < 21; i++) {
+      messages::Block block;
+      auto header = block.mutable_header();
+      header->mutable_id()->CopyFrom(messages::Hasher::random());
+      if (i > 0) {
+        header->mutable_previous_block_hash()->CopyFrom(
+            _chain.back().header().id());
+      }
+      header->set_height(i);
+      _chain.push_back(block);
+    }
+  }
+
+  messages::Header reply_header(const messages::Message &request) {
+    messages::Header header;
+    header.set_request_id(request.header().id());
+    return header;
+  }
+
+  void reply_headers(const messages::Message &request) {
+    const auto &get_block = request.bodies(0).get_block();
+    messages::BlockHeaders block_headers;
+    for (auto i = get_block.height();
+         i < _chain.size() && i < get_block.height() + get_block.count();
+         i++) {
+      block_headers.add_headers()->CopyFrom(_chain[i].header());
+    }
+    ASSERT_TRUE(
+        _block_sync.handle_headers(reply_header(request), block_headers));
+  }
+
+  void reply_blocks(const messages::Message &request) {
+    const auto &get_block = request.bodies(0).get_block();
+    ASSERT_FALSE(get_block.headers_only());
+    for (auto i = get_block.height();
+         i < get_block.height() + get_block.count(); i++) {
+      ASSERT_TRUE(_block_sync.handle_block(reply_header(request), _chain[i]));
+    }
+  }
+
+  //! retries of the request in flight at a height
+  uint32_t retries(messages::BlockHeight height) const {
+    for (const auto &[id, request] : _block_sync._requests) {
+      if (request.height == height) {
+        return request.retries;
+      }
+    }
+    return networking::BlockSync::MAX_RETRIES + 1;
+  }
+
+  void expire_requests() {
+    for (auto &[id, request] : _block_sync._requests) {
+      request.deadline = Timer::now() - std::chrono::seconds(1);
+    }
+  }
+};
+
+TEST_F(BlockSync, sync) {
+  ASSERT_TRUE(_block_sync.start(0, _chain[0].header().id(), _peer_ids));
+  ASSERT_FALSE(_block_sync.start(0, _chain[0].header().id(), _peer_ids));
+  ASSERT_EQ(_requests.size(), 1);
+  const auto headers_request = _requests[0].first;
+  ASSERT_TRUE(headers_request.bodies(0).get_block().headers_only());
+  ASSERT_EQ(headers_request.bodies(0).get_block().height(), 1);
+  reply_headers(headers_request);
+
+  // 20 blocks by windows of 8, each of the 2 peers has 2 requests at most
+  ASSERT_EQ(_requests.size(), 4);
+  ASSERT_NE(_requests[1].second, _requests[2].second);
+  ASSERT_EQ(_requests[1].first.bodies(0).get_block().height(), 1);
+  ASSERT_EQ(_requests[2].first.bodies(0).get_block().height(), 9);
+  ASSERT_EQ(_requests[3].first.bodies(0).get_block().height(), 17);
+  ASSERT_EQ(_requests[3].first.bodies(0).get_block().count(), 4);
+
+  // The blocks are added in order whatever the order of the replies
+  reply_blocks(_requests[3].first);
+  reply_blocks(_requests[2].first);
+  ASSERT_TRUE(_added_heights.empty());
+  reply_blocks(_requests[1].first);
+  ASSERT_EQ(_added_heights.size(), 20);
+  for (std::size_t i = 0; i < _added_heights.size(); i++) {
+    ASSERT_EQ(_added_heights[i], static_cast<messages::BlockHeight>(i + 1));
+  }
+  ASSERT_FALSE(_block_sync.is_running());
+
+  // The blocks are not taken once the sync is done
+  ASSERT_FALSE(
+      _block_sync.handle_block(reply_header(_requests[1].first), _chain[1]));
+}
+
+TEST_F(BlockSync, retry) {
+  ASSERT_TRUE(_block_sync.start(0, _chain[0].header().id(), _peer_ids));
+  reply_headers(_requests[0].first);
+  ASSERT_EQ(_requests.size(), 4);
+  const auto timed_out_request = _requests[1];
+
+  // Only the missing part of the window is asked again, to the other peer
+  auto partial_reply = timed_out_request.first;
+  partial_reply.mutable_bodies(0)->mutable_get_block()->set_count(3);
+  reply_blocks(partial_reply);
+  reply_blocks(_requests[2].first);
+  reply_blocks(_requests[3].first);
+  expire_requests();
+  _block_sync.update(_peer_ids);
+  ASSERT_EQ(_requests.size(), 5);
+  const auto retried_request = _requests.back();
+  ASSERT_NE(retried_request.second, timed_out_request.second);
+  ASSERT_EQ(retried_request.first.bodies(0).get_block().height(), 4);
+  ASSERT_EQ(retried_request.first.bodies(0).get_block().count(), 5);
+
+  reply_blocks(retried_request.first);
+  ASSERT_EQ(_added_heights.size(), 20);
+  ASSERT_FALSE(_block_sync.is_running());
+}
+
+TEST_F(BlockSync, partial_reply) {
+  ASSERT_TRUE(_block_sync.start(0, _chain[0].header().id(), _peer_ids));
+  reply_headers(_requests[0].first);
+  ASSERT_EQ(_requests.size(), 4);
+  reply_blocks(_requests[2].first);
+  reply_blocks(_requests[3].first);
+
+  // A peer that sends the first blocks of a window did answer, the rest is
+  // asked again without counting a retry
+  for (uint32_t i = 0; i <= networking::BlockSync::MAX_RETRIES; i++) {
+    auto partial_reply = _requests.back().first;
+    if (i == 0) {
+      partial_reply = _requests[1].first;
+    }
+    partial_reply.mutable_bodies(0)->mutable_get_block()->set_count(1);
+    reply_blocks(partial_reply);
+    expire_requests();
+    _block_sync.update(_peer_ids);
+    ASSERT_TRUE(_block_sync.is_running());
+    ASSERT_EQ(_requests.back().first.bodies(0).get_block().height(), i + 2);
+    ASSERT_EQ(retries(i + 2), 0);
+  }
+
+  // A request without any answer counts as a retry
+  const auto height = _requests.back().first.bodies(0).get_block().height();
+  expire_requests();
+  _block_sync.update(_peer_ids);
+  ASSERT_EQ(retries(height), 1);
+}
+
+TEST_F(BlockSync, wrong_headers) {
+  ASSERT_TRUE(_block_sync.start(0, messages::Hasher::random(), _peer_ids));
+  reply_headers(_requests[0].first);
+  ASSERT_FALSE(_block_sync.is_running());
+  ASSERT_EQ(_requests.size(), 1);
+}
+
+}  // namespace test
+}  // namespace networking
+}  // namespace neuro
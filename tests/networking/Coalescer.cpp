@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "networking/Coalescer.hpp"
+
+namespace neuro {
+namespace networking {
+namespace test {
+
+class Coalescer : public ::testing::Test {
+ protected:
+  std::vector<std::pair<networking::Coalescer::PeerID, messages::Message>>
+      _sent;
+
+  networking::Coalescer make_coalescer(std::size_t max_bytes,
+                                       std::chrono::milliseconds max_delay) {
+    return networking::Coalescer(
+        [this](const messages::Message &message,
+               networking::Coalescer::PeerID peer) {
+          _sent.emplace_back(peer, message);
+          return true;
+        },
+        max_bytes, max_delay);
+  }
+
+  static messages::Body body(std::size_t size) {
+    messages::Body body;
+    body.mutable_transaction()->mutable_id()->set_data(
+        std::string(size, 'a'));
+    return body;
+  }
+};
+
+TEST_F(Coalescer, pack) {
+  auto coalescer = make_coalescer(networking::Coalescer::DEFAULT_MAX_BYTES,
+                                  std::chrono::hours(1));
+  const int nb_bodies = 100;
+  for (int i = 0; i < nb_bodies; i++) {
+    coalescer.add(1, body(10));
+    coalescer.add(2, body(10));
+  }
+  ASSERT_TRUE(_sent.empty());
+
+  coalescer.flush();
+  ASSERT_TRUE(_sent.empty());
+
+  coalescer.flush(true);
+  ASSERT_EQ(_sent.size(), 2);
+  for (const auto &[peer, message] : _sent) {
+    ASSERT_EQ(message.bodies_size(), nb_bodies);
+    ASSERT_TRUE(message.header().has_ts());
+  }
+  ASSERT_EQ(coalescer.bodies(), 2 * nb_bodies);
+  ASSERT_EQ(coalescer.messages(), 2);
+
+  coalescer.flush(true);
+  ASSERT_EQ(_sent.size(), 2);
+}
+
+TEST_F(Coalescer, max_bytes) {
+  const auto body_size = body(1000).ByteSizeLong();
+  auto coalescer = make_coalescer(3 * body_size, std::chrono::hours(1));
+
+  // The third body fills the batch which is sent right away
+  coalescer.add(1, body(1000));
+  coalescer.add(1, body(1000));
+  ASSERT_TRUE(_sent.empty());
+  coalescer.add(1, body(1000));
+  ASSERT_EQ(_sent.size(), 1);
+  ASSERT_EQ(_sent[0].second.bodies_size(), 3);
+
+  // A body that does not fit sends the pending batch first
+  coalescer.add(1, body(1000));
+  coalescer.add(1, body(3000));
+  ASSERT_EQ(_sent.size(), 3);
+  ASSERT_EQ(_sent[1].second.bodies_size(), 1);
+  ASSERT_EQ(_sent[2].second.bodies_size(), 1);
+}
+
+TEST_F(Coalescer, max_delay) {
+  const auto max_delay = std::chrono::milliseconds(20);
+  auto coalescer = make_coalescer(networking::Coalescer::DEFAULT_MAX_BYTES,
+                                  max_delay);
+  coalescer.add(1, body(10));
+  std::this_thread::sleep_for(max_delay);
+  coalescer.add(2, body(10));
+  coalescer.flush();
+  ASSERT_EQ(_sent.size(), 1);
+  ASSERT_EQ(_sent[0].first, 1);
+
+  std::this_thread::sleep_for(max_delay);
+  coalescer.flush();
+  ASSERT_EQ(_sent.size(), 2);
+  ASSERT_EQ(_sent[1].first, 2);
+}
+
+}  // namespace test
+}  // namespace networking
+}  // namespace neuro
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+
+#include "common/logger.hpp"
+#include "messages/Hasher.hpp"
+#include "networking/CompactBlocks.hpp"
+
+namespace neuro {
+namespace networking {
+namespace test {
+
+messages::Transaction make_transaction() {
+  messages::Transaction transaction;
+  transaction.mutable_id()->CopyFrom(messages::Hasher::random());
+  transaction.mutable_last_seen_block_id()->CopyFrom(
+      messages::Hasher::random());
+  return transaction;
+}
+
+messages::Block make_block(int nb_transactions) {
+  messages::Block block;
+  auto header = block.mutable_header();
+  header->mutable_id()->CopyFrom(messages::Hasher::random());
+  header->mutable_previous_block_hash()->CopyFrom(messages::Hasher::random());
+  header->mutable_timestamp()->set_data(0);
+  header->set_height(1);
+  block.mutable_coinbase()->CopyFrom(make_transaction());
+  for (int i = 0; i < nb_transactions; i++) {
+    block.add_transactions()->CopyFrom(make_transaction());
+  }
+  messages::set_block_hash(&block);
+  return block;
+}
+
+TEST(CompactBlocks, rebuild) {
+  CompactBlocks compact_blocks;
+  const auto block = make_block(100);
+  for (const auto &transaction : block.transactions()) {
+    compact_blocks.add_transaction(transaction);
+  }
+  ASSERT_EQ(compact_blocks.transactions_count(), 100);
+
+  messages::CompactBlock compact_block;
+  ASSERT_TRUE(CompactBlocks::compact(block, &compact_block));
+  ASSERT_EQ(compact_block.short_transaction_ids_size(), 100);
+  LOG_INFO << "Compact block size " << compact_block.ByteSizeLong()
+           << " block size " << block.ByteSizeLong();
+  ASSERT_LT(compact_block.ByteSizeLong(), block.ByteSizeLong() / 2);
+
+  messages::Block rebuilt_block;
+  messages::GetBlockTransactions get_block_transactions;
+  ASSERT_TRUE(compact_blocks.rebuild(compact_block, &rebuilt_block,
+                                     &get_block_transactions));
+  ASSERT_EQ(get_block_transactions.indexes_size(), 0);
+  ASSERT_EQ(rebuilt_block, block);
+  ASSERT_TRUE(CompactBlocks::check_block_id(rebuilt_block));
+
+  // A block rebuilt from a forged compact block does not match its id
+  compact_block.mutable_coinbase()->mutable_id()->CopyFrom(
+      messages::Hasher::random());
+  ASSERT_TRUE(compact_blocks.rebuild(compact_block, &rebuilt_block,
+                                     &get_block_transactions));
+  ASSERT_FALSE(CompactBlocks::check_block_id(rebuilt_block));
+}
+
+TEST(CompactBlocks, missing_transactions) {
+  CompactBlocks compact_blocks;
+  const auto block = make_block(10);
+  for (int i = 0; i < block.transactions_size(); i += 2) {
+    compact_blocks.add_transaction(block.transactions(i));
+  }
+
+  messages::CompactBlock compact_block;
+  ASSERT_TRUE(CompactBlocks::compact(block, &compact_block));
+  messages::Block rebuilt_block;
+  messages::GetBlockTransactions get_block_transactions;
+  ASSERT_FALSE(compact_blocks.rebuild(compact_block, &rebuilt_block,
+                                      &get_block_transactions));
+  ASSERT_EQ(get_block_transactions.block_id(), block.header().id());
+  ASSERT_EQ(get_block_transactions.indexes_size(), 5);
+  ASSERT_EQ(get_block_transactions.indexes(0), 1);
+
+  // The sender answers with the transactions that were asked
+  messages::BlockTransactions block_transactions;
+  ASSERT_TRUE(CompactBlocks::get_transactions(block, get_block_transactions,
+                                              &block_transactions));
+  ASSERT_EQ(block_transactions.transactions_size(), 5);
+
+  auto wrong_block_transactions = block_transactions;
+  wrong_block_transactions.mutable_transactions()->SwapElements(0, 1);
+  ASSERT_FALSE(compact_blocks.complete(wrong_block_transactions,
+                                       &rebuilt_block));
+  ASSERT_TRUE(compact_blocks.complete(block_transactions, &rebuilt_block));
+  ASSERT_EQ(rebuilt_block, block);
+  // The block is not kept once complete
+  ASSERT_FALSE(compact_blocks.complete(block_transactions, &rebuilt_block));
+
+  get_block_transactions.add_indexes(10);
+  ASSERT_FALSE(CompactBlocks::get_transactions(block, get_block_transactions,
+                                               &block_transactions));
+}
+
+TEST(CompactBlocks, short_ids) {
+  const auto block = make_block(2);
+  const auto other_block = make_block(0);
+  const auto &id = block.transactions(0).id();
+
+  // The short ids of a transaction are different for each block
+  ASSERT_EQ(CompactBlocks::short_id(block.header().id(), id),
+            CompactBlocks::short_id(block.header().id(), id));
+  ASSERT_NE(CompactBlocks::short_id(block.header().id(), id),
+            CompactBlocks::short_id(other_block.header().id(), id));
+
+  // A transaction received twice is kept once
+  CompactBlocks compact_blocks(2);
+  compact_blocks.add_transaction(block.transactions(0));
+  compact_blocks.add_transaction(block.transactions(0));
+  compact_blocks.add_transaction(block.transactions(1));
+  ASSERT_EQ(compact_blocks.transactions_count(), 2);
+  messages::Transaction transaction;
+  ASSERT_TRUE(compact_blocks.get_transaction(id, &transaction));
+  ASSERT_EQ(transaction, block.transactions(0));
+
+  // The oldest transactions are dropped first
+  compact_blocks.add_transaction(other_block.coinbase());
+  ASSERT_EQ(compact_blocks.transactions_count(), 2);
+  ASSERT_FALSE(compact_blocks.get_transaction(id, &transaction));
+  ASSERT_TRUE(compact_blocks.get_transaction(block.transactions(1).id(),
+                                             &transaction));
+
+  // A block with a short id twice cannot be compacted
+  auto duplicated_block = block;
+  duplicated_block.add_transactions()->CopyFrom(block.transactions(0));
+  messages::CompactBlock compact_block;
+  ASSERT_FALSE(CompactBlocks::compact(duplicated_block, &compact_block));
+}
+
+}  // namespace test
+}  // namespace networking
+}  // namespace neuro
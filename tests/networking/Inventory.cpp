@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include "messages/Hasher.hpp"
+#include "networking/Inventory.hpp"
+
+namespace neuro {
+namespace networking {
+namespace test {
+
+class Inventory : public ::testing::Test {
+ protected:
+  static constexpr networking::Inventory::PeerID NB_PEERS = 9;
+  networking::Inventory _inventory;
+
+  Inventory() {
+    for (networking::Inventory::PeerID peer = 0; peer < NB_PEERS; peer++) {
+      _inventory.add_peer(peer);
+    }
+  }
+
+  bool is_tracked(networking::Inventory::PeerID peer) const {
+    return _inventory._known_ids_by_peer.count(peer) > 0;
+  }
+
+  void expire_requests() {
+    for (auto &[id, request] : _inventory._requests) {
+      request.deadline = Timer::now() - std::chrono::seconds(1);
+    }
+  }
+};
+
+TEST_F(Inventory, announce) {
+  const auto id = messages::Hasher::random();
+  const std::vector<networking::Inventory::PeerID> peers{1, 2, 3};
+
+  // Received from peer 1, it is only announced to the others
+  ASSERT_TRUE(_inventory.is_new_transaction(id, 1));
+  ASSERT_TRUE(_inventory.add_transaction(id, 1));
+  ASSERT_FALSE(_inventory.is_new_transaction(id, 2));
+  ASSERT_EQ(_inventory.duplicates(), 1);
+  _inventory.announce_transaction(id, peers);
+  _inventory.announce_transaction(id, peers);
+  ASSERT_EQ(_inventory.announced(), 1);
+
+  const auto inventories = _inventory.flush();
+  ASSERT_EQ(inventories.size(), 1);
+  ASSERT_EQ(inventories[0].first, 3);
+  ASSERT_EQ(inventories[0].second.transaction_ids_size(), 1);
+  ASSERT_EQ(inventories[0].second.transaction_ids(0), id);
+  ASSERT_TRUE(_inventory.flush().empty());
+}
+
+TEST_F(Inventory, batch) {
+  const std::size_t nb_transactions =
+      networking::Inventory::MAX_IDS_PER_MESSAGE + 1;
+  for (std::size_t i = 0; i < nb_transactions; i++) {
+    const auto id = messages::Hasher::random();
+    _inventory.add_transaction(id, {});
+    _inventory.announce_transaction(id, {1});
+  }
+  const auto inventories = _inventory.flush();
+  ASSERT_EQ(inventories.size(), 2);
+  ASSERT_EQ(inventories[0].second.transaction_ids_size(),
+            networking::Inventory::MAX_IDS_PER_MESSAGE);
+  ASSERT_EQ(inventories[1].second.transaction_ids_size(), 1);
+}
+
+TEST_F(Inventory, request) {
+  // The same transaction is announced by all the peers but asked once
+  const int nb_peers = 8;
+  messages::Inventory inventory;
+  inventory.add_transaction_ids()->CopyFrom(messages::Hasher::random());
+  messages::GetInventory get_inventory;
+  ASSERT_TRUE(_inventory.handle_inventory(0, inventory, &get_inventory));
+  ASSERT_EQ(get_inventory.transaction_ids_size(), 1);
+  for (int peer = 1; peer < nb_peers; peer++) {
+    ASSERT_FALSE(_inventory.handle_inventory(peer, inventory, &get_inventory));
+  }
+  ASSERT_EQ(_inventory.requested(), 1);
+
+  // Asked again to the next peer that announced it once the request timed
+  // out
+  ASSERT_TRUE(_inventory.retry_requests().empty());
+  expire_requests();
+  auto requests = _inventory.retry_requests();
+  ASSERT_EQ(requests.size(), 1);
+  ASSERT_EQ(requests[0].first, 1);
+  ASSERT_EQ(requests[0].second.transaction_ids(0),
+            inventory.transaction_ids(0));
+  ASSERT_EQ(_inventory.requested(), 2);
+
+  // A forged transaction with the same id is rejected by the consensus, the
+  // transaction is still asked
+  ASSERT_TRUE(_inventory.is_new_transaction(inventory.transaction_ids(0), 1));
+  _inventory.remove_peer(1);
+  requests = _inventory.retry_requests();
+  ASSERT_EQ(requests.size(), 1);
+  ASSERT_EQ(requests[0].first, 2);
+
+  // Not asked anymore once received, and not announced to the peers that
+  // announced it
+  ASSERT_TRUE(_inventory.add_transaction(inventory.transaction_ids(0), 2));
+  expire_requests();
+  ASSERT_TRUE(_inventory.retry_requests().empty());
+  ASSERT_FALSE(_inventory.handle_inventory(2, inventory, &get_inventory));
+  ASSERT_EQ(_inventory.received(), 1);
+  ASSERT_EQ(_inventory.duplicates(), 1);
+  _inventory.announce_transaction(inventory.transaction_ids(0),
+                                  {0, 2, 3, nb_peers});
+  const auto inventories = _inventory.flush();
+  ASSERT_EQ(inventories.size(), 1);
+  ASSERT_EQ(inventories[0].first, nb_peers);
+}
+
+TEST_F(Inventory, removed_peer) {
+  const auto id = messages::Hasher::random();
+  messages::Inventory inventory;
+  inventory.add_transaction_ids()->CopyFrom(id);
+  messages::GetInventory get_inventory;
+  _inventory.remove_peer(1);
+
+  // The messages of a peer handled after its removal are ignored
+  ASSERT_FALSE(_inventory.handle_inventory(1, inventory, &get_inventory));
+  ASSERT_TRUE(_inventory.is_new_transaction(id, 1));
+  ASSERT_TRUE(_inventory.add_transaction(id, 1));
+  _inventory.announce_transaction(id, {1, NB_PEERS});
+  ASSERT_TRUE(_inventory.flush().empty());
+  ASSERT_FALSE(is_tracked(1));
+  ASSERT_FALSE(is_tracked(NB_PEERS));
+
+  // A new connection with the same id starts with nothing known
+  _inventory.add_peer(1);
+  _inventory.announce_transaction(id, {1});
+  const auto inventories = _inventory.flush();
+  ASSERT_EQ(inventories.size(), 1);
+  ASSERT_EQ(inventories[0].first, 1);
+}
+
+}  // namespace test
+}  // namespace networking
+}  // namespace neuro
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include "common/logger.hpp"
+#include "crypto/Ecc.hpp"
+#include "messages/Hasher.hpp"
+#include "messages/Message.hpp"
+#include "networking/tcp/Compression.hpp"
+
+namespace neuro {
+namespace networking {
+namespace test {
+
+class Compression : public ::testing::Test {
+ protected:
+  const std::size_t _nb_keys = 16;
+  const std::size_t _nb_transactions = 500;
+  std::vector<crypto::Ecc> _keys{_nb_keys};
+  tcp::Compressor _compressor;
+  tcp::Decompressor _decompressor;
+
+  // Block shaped like the ones of the network, the ids and signatures do not
+  // compress but the keys and amounts repeat
+  messages::Block block() {
+    messages::Block block;
+    auto header = block.mutable_header();
+    header->mutable_id()->CopyFrom(messages::Hasher::random());
+    header->mutable_timestamp()->set_data(time());
+    header->mutable_previous_block_hash()->CopyFrom(
+        messages::Hasher::random());
+    header->mutable_author()->mutable_signature()->CopyFrom(
+        messages::Hasher::random());
+    _keys[0].key_pub().save(header->mutable_author()->mutable_key_pub());
+    header->set_height(1);
+    for (std::size_t i = 0; i < _nb_transactions; i++) {
+      auto transaction = block.add_transactions();
+      transaction->mutable_id()->CopyFrom(messages::Hasher::random());
+      auto input = transaction->add_inputs();
+      _keys[i % _nb_keys].key_pub().save(input->mutable_key_pub());
+      input->mutable_value()->set_value(100);
+      input->mutable_signature()->CopyFrom(messages::Hasher::random());
+      auto output = transaction->add_outputs();
+      _keys[(i + 1) % _nb_keys].key_pub().save(output->mutable_key_pub());
+      output->mutable_value()->set_value(100);
+      transaction->mutable_last_seen_block_id()->CopyFrom(header->id());
+    }
+    return block;
+  }
+};
+
+TEST_F(Compression, block) {
+  const auto buffer = messages::to_buffer(block());
+  ASSERT_TRUE(buffer);
+  ASSERT_LE(buffer->size(), static_cast<std::size_t>(MAX_MESSAGE_SIZE));
+
+  Buffer compressed;
+  ASSERT_TRUE(_compressor.compress(*buffer, &compressed));
+  ASSERT_LT(compressed.size(), buffer->size());
+  LOG_INFO << "Block of " << _nb_transactions << " transactions compressed "
+           << buffer->size() << " -> " << compressed.size() << " bytes";
+
+  Buffer decompressed;
+  ASSERT_TRUE(_decompressor.decompress(compressed, MAX_MESSAGE_SIZE,
+                                       &decompressed));
+  ASSERT_EQ(decompressed, *buffer);
+
+  // The contexts are reused
+  const auto other_buffer = messages::to_buffer(block());
+  ASSERT_TRUE(_compressor.compress(*other_buffer, &compressed));
+  ASSERT_TRUE(_decompressor.decompress(compressed, MAX_MESSAGE_SIZE,
+                                       &decompressed));
+  ASSERT_EQ(decompressed, *other_buffer);
+}
+
+TEST_F(Compression, small) {
+  const Buffer buffer(tcp::Compressor::MIN_SIZE - 1, 0);
+  Buffer compressed;
+  ASSERT_FALSE(_compressor.compress(buffer, &compressed));
+}
+
+TEST_F(Compression, invalid) {
+  // A frame whose content is bigger than a message is refused
+  const Buffer buffer(MAX_MESSAGE_SIZE + 1, 0);
+  Buffer compressed;
+  ASSERT_TRUE(_compressor.compress(buffer, &compressed));
+  Buffer decompressed;
+  ASSERT_FALSE(
+      _decompressor.decompress(compressed, MAX_MESSAGE_SIZE, &decompressed));
+
+  const Buffer garbage(tcp::Compressor::MIN_SIZE, 42);
+  ASSERT_FALSE(
+      _decompressor.decompress(garbage, MAX_MESSAGE_SIZE, &decompressed));
+
+  // Truncated frame
+  ASSERT_TRUE(_compressor.compress(Buffer(MAX_MESSAGE_SIZE, 0), &compressed));
+  compressed.resize(compressed.size() / 2);
+  ASSERT_FALSE(
+      _decompressor.decompress(compressed, MAX_MESSAGE_SIZE, &decompressed));
+}
+
+}  // namespace test
+}  // namespace networking
+}  // namespace neuro
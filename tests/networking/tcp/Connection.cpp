@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
+#include <thread>
 
+#include "common/logger.hpp"
 #include "networking/tcp/Connection.hpp"
 
 namespace neuro {
@@ -13,8 +15,85 @@ TEST(Connection, constructor) {
   auto queue = messages::Queue{};
   auto conf = messages::config::Config{Path("./bot2.json")};
   auto peer = std::make_shared<messages::Peer>(conf.networking());
-  tcp::Connection connection_0(0, &queue, socket, peer);
-  tcp::Connection connection_1(345, &queue, socket, peer);
+  messages::Peers peers(messages::_KeyPub(), conf.networking());
+  tcp::Connection connection_0(0, &queue, &peers, socket, peer);
+  tcp::Connection connection_1(345, &queue, &peers, socket, peer);
+}
+
+TEST(Connection, send) {
+  const int nb_threads = 4;
+  const int messages_per_thread = 25000;
+  const std::size_t body_size = 64;
+
+  boost::asio::io_context io_context;
+  bai::tcp::acceptor acceptor(
+      io_context, bai::tcp::endpoint(bai::address_v4::loopback(), 0));
+  auto socket = std::make_shared<bai::tcp::socket>(io_context);
+  bai::tcp::socket remote_socket(io_context);
+  socket->connect(acceptor.local_endpoint());
+  acceptor.accept(remote_socket);
+  auto work = boost::asio::make_work_guard(io_context);
+  std::thread io_context_thread([&io_context]() { io_context.run(); });
+
+  auto queue = messages::Queue{};
+  auto conf = messages::config::Config{Path("./bot2.json")};
+  auto peer = std::make_shared<messages::Peer>(conf.networking());
+  messages::Peers peers(messages::_KeyPub(), conf.networking());
+  auto connection =
+      std::make_shared<tcp::Connection>(0, &queue, &peers, socket, peer);
+
+  // Every thread sends bodies filled with its own index so that interleaved
+  // messages can be detected on the other side
+  const auto t0 = Timer::now();
+  std::vector<std::thread> senders;
+  for (int i = 0; i < nb_threads; i++) {
+    senders.emplace_back([&, i]() {
+      auto header = std::make_shared<Buffer>(sizeof(tcp::HeaderPattern), 0);
+      reinterpret_cast<tcp::HeaderPattern *>(header->data())->size = body_size;
+      auto body = std::make_shared<Buffer>(body_size, i);
+      for (int j = 0; j < messages_per_thread; j++) {
+        while (!connection->send(header, body)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<int> received(nb_threads, 0);
+  Buffer header(sizeof(tcp::HeaderPattern), 0);
+  Buffer body;
+  for (int i = 0; i < nb_threads * messages_per_thread; i++) {
+    boost::asio::read(remote_socket,
+                      boost::asio::buffer(header.data(), header.size()));
+    const auto size =
+        reinterpret_cast<const tcp::HeaderPattern *>(header.data())->size;
+    ASSERT_EQ(size, body_size);
+    body.resize(size);
+    boost::asio::read(remote_socket, boost::asio::buffer(body.data(), size));
+    const auto index = body[0];
+    ASSERT_LT(index, nb_threads);
+    ASSERT_EQ(Buffer(body_size, index), body);
+    received[index]++;
+  }
+  const auto duration = std::chrono::duration<double>(Timer::now() - t0);
+  for (auto &sender : senders) {
+    sender.join();
+  }
+  for (const auto nb_received : received) {
+    ASSERT_EQ(nb_received, messages_per_thread);
+  }
+  LOG_INFO << "Sent " << nb_threads * messages_per_thread << " messages of "
+           << body_size << " bytes on a single connection at "
+           << nb_threads * messages_per_thread / duration.count()
+           << " messages/s";
+
+  while (connection->queued_messages() > 0) {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(connection->queued_bytes(), 0);
+  work.reset();
+  io_context.stop();
+  io_context_thread.join();
 }
 
 }  // namespace test
@@ -1,9 +1,11 @@
 #include <gtest/gtest.h>
 #include <src/messages/config/Config.hpp>
 
+#include "common/logger.hpp"
 #include "crypto/Ecc.hpp"
 #include "messages/Peers.hpp"
 #include "networking/tcp/Tcp.hpp"
+#include "tooling/blockgen.hpp"
 
 namespace neuro {
 namespace networking {
@@ -35,6 +37,86 @@ class Tcp {
     ASSERT_EQ(tcp1._connections.size(), 1);
     ASSERT_EQ(tcp2._connections.size(), 1);
   }
+
+  void test_send_all() {
+    const int nb_peers = 8;
+    // The connections use their own io_context, which is only run once their
+    // queued frames are checked. It outlives the connections.
+    boost::asio::io_context io_context;
+    auto queue = messages::Queue{};
+    crypto::Ecc keys;
+    auto conf = messages::config::Config{Path("bot1.json")};
+    messages::Peers peers(keys.key_pub(), conf.networking());
+    networking::Tcp tcp(&queue, &peers, &keys, conf.networking());
+
+    bai::tcp::acceptor acceptor(
+        io_context, bai::tcp::endpoint(bai::address_v4::loopback(), 0));
+    std::vector<bai::tcp::socket> remote_sockets;
+    remote_sockets.reserve(nb_peers);
+    std::vector<std::shared_ptr<tcp::Connection>> connections;
+    for (int i = 0; i < nb_peers; i++) {
+      auto socket = std::make_shared<bai::tcp::socket>(io_context);
+      socket->connect(acceptor.local_endpoint());
+      acceptor.accept(remote_sockets.emplace_back(io_context));
+      auto peer = std::make_shared<messages::Peer>(conf.networking());
+      crypto::Ecc peer_keys;
+      peer_keys.key_pub().save(peer->mutable_key_pub());
+      ASSERT_TRUE(peers.insert(peer));
+      peer->set_connection_id(i);
+      peers.set_status(peer.get(), messages::Peer::CONNECTED);
+      auto connection =
+          std::make_shared<tcp::Connection>(i, &queue, &peers, socket, peer);
+      // Half of the peers accept compressed frames
+      if (i % 2 == 1) {
+        connection->_remote_compression = tcp::Compression::ZSTD;
+      }
+      std::lock_guard lock(tcp._connections_mutex);
+      tcp._connections.emplace(i, connection);
+      connections.push_back(connection);
+    }
+
+    // Relaying a block is the most common broadcast
+    std::vector<crypto::Ecc> block_keys(100);
+    messages::Message message;
+    message.add_bodies()->mutable_block()->CopyFrom(
+        tooling::blockgen::gen_block0(block_keys, messages::NCCAmount(1000), 0)
+            .block());
+    ASSERT_EQ(tcp.send_all(message),
+              networking::TransportLayer::SendResult::ALL_GOOD);
+
+    // The message is serialized once: the connections that use the same codec
+    // all queued the same buffers
+    std::shared_ptr<const Buffer> headers[2], bodies[2];
+    for (int i = 0; i < nb_peers; i++) {
+      const auto &write_queue = connections[i]->_write_queue;
+      ASSERT_EQ(write_queue.size(), 1);
+      const auto &frame = write_queue.front();
+      if (!bodies[i % 2]) {
+        headers[i % 2] = frame.header;
+        bodies[i % 2] = frame.body;
+      }
+      ASSERT_EQ(frame.header, headers[i % 2]);
+      ASSERT_EQ(frame.body, bodies[i % 2]);
+    }
+    ASSERT_EQ(bodies[0]->size(), message.ByteSizeLong());
+    // The compressed frame is only used if it is smaller
+    ASSERT_TRUE(bodies[1] == bodies[0] ||
+                bodies[1]->size() < bodies[0]->size());
+
+    // Every remote peer receives the frame of its codec
+    io_context.run();
+    for (int i = 0; i < nb_peers; i++) {
+      ASSERT_EQ(connections[i]->queued_messages(), 0);
+      Buffer header(headers[i % 2]->size(), 0);
+      boost::asio::read(remote_sockets[i],
+                        boost::asio::buffer(header.data(), header.size()));
+      ASSERT_EQ(header, *headers[i % 2]);
+      Buffer body(bodies[i % 2]->size(), 0);
+      boost::asio::read(remote_sockets[i],
+                        boost::asio::buffer(body.data(), body.size()));
+      ASSERT_EQ(body, *bodies[i % 2]);
+    }
+  }
 };
 
 TEST(Tcp, ConnectionTest) {
@@ -42,6 +124,11 @@ TEST(Tcp, ConnectionTest) {
   tcp_test.test_connection();
 }
 
+TEST(Tcp, send_all) {
+  networking::test::Tcp tcp_test;
+  tcp_test.test_send_all();
+}
+
 }  // namespace test
 }  // namespace networking
 }  // namespace neuro
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "common/logger.hpp"
+#include "ledger/LedgerMongodb.hpp"
+#include "tooling/ConsensusReplay.hpp"
+#include "tooling/Simulator.hpp"
+
+namespace neuro {
+namespace tooling {
+namespace tests {
+
+class ConsensusReplay : public ::testing::Test {
+ public:
+  const std::string db_url = "mongodb://mongo:27017";
+  const std::string db_name = "test_consensus_replay";
+  const std::string replay_db_name = "test_consensus_replay_replay";
+  const messages::NCCAmount ncc_block0 = messages::NCCAmount(1000000);
+  const int nb_keys = 10;
+
+ protected:
+  tooling::Simulator simulator;
+
+  ConsensusReplay()
+      : simulator(tooling::Simulator::StaticSimulator(db_url, db_name, nb_keys,
+                                                       ncc_block0)) {}
+};
+
+TEST_F(ConsensusReplay, read_block) {
+  std::stringstream stream;
+  ASSERT_EQ(tooling::ConsensusReplay::dump(*simulator.ledger, &stream), 1u);
+  const auto block0 = tooling::ConsensusReplay::read_block(&stream);
+  ASSERT_TRUE(block0);
+  messages::Block expected;
+  ASSERT_TRUE(simulator.ledger->get_block(0, &expected));
+  messages::sort_transactions(&expected);
+  ASSERT_EQ(*block0, expected);
+  ASSERT_FALSE(tooling::ConsensusReplay::read_block(&stream));
+}
+
+TEST_F(ConsensusReplay, replay) {
+  const int nb_blocks = 3 * simulator.consensus->config().blocks_per_assembly;
+  simulator.run(nb_blocks, 2);
+  const uint64_t height = simulator.ledger->height();
+
+  std::stringstream stream;
+  ASSERT_EQ(tooling::ConsensusReplay::dump(*simulator.ledger, &stream),
+            height + 1);
+  const auto block0 = tooling::ConsensusReplay::read_block(&stream);
+  ASSERT_TRUE(block0);
+
+  tooling::ConsensusReplay replay(db_url, replay_db_name, *block0,
+                                  simulator.consensus->config());
+  ASSERT_TRUE(replay.replay(&stream));
+  const auto &stats = replay.stats();
+  LOG_INFO << "Consensus replay" << std::endl << stats;
+  ASSERT_EQ(stats.blocks, height);
+  ASSERT_GT(stats.transactions, 0u);
+  ASSERT_GT(stats.assemblies, 0u);
+  ASSERT_EQ(static_cast<uint64_t>(replay.ledger()->height()), height);
+
+  messages::TaggedBlock expected_tip, tip;
+  ASSERT_TRUE(simulator.ledger->get_last_block(&expected_tip, false));
+  ASSERT_TRUE(replay.ledger()->get_last_block(&tip, false));
+  ASSERT_EQ(tip.block().header().id(), expected_tip.block().header().id());
+}
+
+}  // namespace tests
+}  // namespace tooling
+}  // namespace neuro